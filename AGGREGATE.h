@@ -0,0 +1,110 @@
+#ifndef Aggregate_h
+#define Aggregate_h
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include "POOL.h"
+
+using namespace std;
+
+// The distinct words of one document with their counts, in a small open
+// addressing table that is reused from document to document. Ingestion
+// counts a document's tokens here and then touches the global dictionary
+// once per distinct word instead of once per token. Words are copied back
+// to back into one string, so the table keeps no pointers into the caller's
+// buffers.
+class DocumentTerms
+{
+  public:
+
+    DocumentTerms( ) : tokenCount( 0 ) { }
+
+    void add( string_view word ); // count one occurrence
+    template <class Function>
+    void forEach( Function f ) const; // f(word, count) in order of first appearance
+    void clear( ); // forget the words, keep the memory
+
+    size_t size( ) const { return counts.size( ); }
+    size_t tokens( ) const { return tokenCount; }
+
+  private:
+
+    string text; // Distinct words, back to back
+    vector<uint32_t> ends; // Word i is text[ends[i - 1], ends[i])
+    vector<uint32_t> counts;
+    vector<uint32_t> slots; // Linear probing table of word index + 1, 0 is empty
+    vector<uint32_t> occupied; // Slots in use, so clear() does not sweep the whole table
+    size_t tokenCount;
+
+    string_view word( size_t i ) const;
+    size_t findSlot( string_view word, uint64_t h ) const;
+    void grow( );
+};
+
+inline string_view DocumentTerms::word( size_t i ) const
+{
+    size_t begin = i == 0 ? 0 : ends[ i - 1 ];
+    return string_view( text ).substr( begin, ends[ i ] - begin );
+}
+
+inline size_t DocumentTerms::findSlot( string_view w, uint64_t h ) const
+{
+    size_t mask = slots.size( ) - 1;
+    size_t pos = h & mask;
+    while ( slots[ pos ] != 0 && word( slots[ pos ] - 1 ) != w )
+        pos = ( pos + 1 ) & mask;
+    return pos;
+}
+
+// Double the table and reinsert every word
+inline void DocumentTerms::grow( )
+{
+    slots.assign( slots.empty( ) ? 256 : slots.size( ) * 2, 0 );
+    occupied.clear( );
+    for ( size_t i = 0; i < counts.size( ); i++ )
+    {
+        size_t pos = findSlot( word( i ), termHash( word( i ) ) );
+        slots[ pos ] = uint32_t( i + 1 );
+        occupied.push_back( uint32_t( pos ) );
+    }
+}
+
+inline void DocumentTerms::add( string_view w )
+{
+    tokenCount++;
+    if ( ( counts.size( ) + 1 ) * 10 > slots.size( ) * 7 )    // keep the load under 0.7
+        grow( );
+    size_t pos = findSlot( w, termHash( w ) );
+    if ( slots[ pos ] != 0 )
+    {
+        counts[ slots[ pos ] - 1 ]++;
+        return;
+    }
+    text.append( w.data( ), w.size( ) );
+    ends.push_back( uint32_t( text.size( ) ) );
+    counts.push_back( 1 );
+    slots[ pos ] = uint32_t( counts.size( ) );
+    occupied.push_back( uint32_t( pos ) );
+}
+
+template <class Function>
+void DocumentTerms::forEach( Function f ) const
+{
+    for ( size_t i = 0; i < counts.size( ); i++ )
+        f( word( i ), counts[ i ] );
+}
+
+inline void DocumentTerms::clear( )
+{
+    for ( uint32_t pos : occupied )
+        slots[ pos ] = 0;
+    occupied.clear( );
+    text.clear( );
+    ends.clear( );
+    counts.clear( );
+    tokenCount = 0;
+}
+
+#endif /* Aggregate_h */
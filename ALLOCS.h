@@ -0,0 +1,46 @@
+#ifndef Allocs_h
+#define Allocs_h
+
+#include <atomic>
+#include <new>
+#include <cstdlib>
+
+using namespace std;
+
+// Global allocation counter, compiled in with -DCOUNT_ALLOCATIONS.
+// It replaces the global operator new and delete, so this header must be
+// included by exactly one translation unit of a program (main.cpp).
+// Without the flag nothing is replaced and allocationCount() returns -1.
+
+#ifdef COUNT_ALLOCATIONS
+
+inline atomic<long long> allocationTotal{0}; // Calls to operator new since the program started
+
+void * operator new(size_t size) {
+    allocationTotal.fetch_add(1, memory_order_relaxed);
+    void * p = malloc(size == 0 ? 1 : size);
+    if (p == nullptr)
+        throw bad_alloc();
+    return p;
+}
+
+void operator delete(void * p) noexcept {
+    free(p);
+}
+
+void operator delete(void * p, size_t) noexcept {
+    free(p);
+}
+
+#endif
+
+// Function to read the number of allocations so far, -1 if they are not counted
+inline long long allocationCount() {
+#ifdef COUNT_ALLOCATIONS
+    return allocationTotal.load(memory_order_relaxed);
+#else
+    return -1;
+#endif
+}
+
+#endif /* Allocs_h */
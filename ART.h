@@ -0,0 +1,972 @@
+#ifndef ART_h
+#define ART_h
+
+#include <string>
+#include <string_view>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <utility>
+#include "MEMORY.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+// Adaptive radix tree (Leis et al., ICDE 2013) keyed on strings.
+// Inner nodes grow and shrink between four layouts (Node4, Node16, Node48,
+// Node256) with the number of children, and chains of single-child nodes
+// are collapsed into a compressed path stored in the node (path
+// compression). Up to ART_MAX_PREFIX bytes of the path are kept in the
+// node; longer paths are checked against a leaf below it (optimistic
+// compression). Every key is treated as if it ended in a 0 byte, so keys
+// must not contain '\0' themselves; this lets a word and its extensions
+// ("car", "cart") live in the same tree. Children are kept in byte order,
+// so iteration visits the keys in sorted order. Leaves hold a string_view
+// of their key: the caller keeps the bytes alive for the life of the tree
+// (the search index interns them in the shared TermPool).
+
+static const int ART_MAX_PREFIX = 10;
+
+enum ArtNodeType : uint8_t { ART_LEAF, ART_NODE4, ART_NODE16, ART_NODE48, ART_NODE256 };
+
+struct ArtHeader {
+
+    uint8_t type;
+};
+
+struct ArtNode : ArtHeader {
+
+    uint16_t numChildren;
+    uint32_t prefixLength; // Length of the compressed path, may exceed ART_MAX_PREFIX
+    unsigned char prefix[ART_MAX_PREFIX]; // First bytes of the compressed path
+};
+
+struct ArtNode4 : ArtNode {
+
+    unsigned char keys[4];
+    ArtHeader * children[4];
+};
+
+struct ArtNode16 : ArtNode {
+
+    unsigned char keys[16];
+    ArtHeader * children[16];
+};
+
+struct ArtNode48 : ArtNode {
+
+    unsigned char childIndex[256]; // 0 means no child, otherwise position + 1 in children
+    ArtHeader * children[48];
+};
+
+struct ArtNode256 : ArtNode {
+
+    ArtHeader * children[256];
+};
+
+template <class value>
+struct ArtLeaf : ArtHeader {
+
+    string_view key; // The tree does not own the key bytes
+    value details;
+};
+
+template <class value>
+class AdaptiveRadixTree
+{
+  public:
+
+    AdaptiveRadixTree( ) : root( nullptr ), count( 0 ) { }
+    ~AdaptiveRadixTree( ) { makeEmpty( ); }
+
+    value * find( string_view key );
+    const value * find( string_view key ) const;
+    bool insert( string_view key, const value & details ); // false (and no change) if present
+    bool insert( string_view key, value && details );
+    void update( string_view key, const value & details ); // replace the details of key, insert if absent
+    void update( string_view key, value && details );
+    bool remove( string_view key ); // false if key is absent
+    void makeEmpty( );
+    size_t size( ) const { return count; }
+
+    template <class Function>
+    void forEach( Function f ) const; // f(key, details) in sorted order
+    template <class Function>
+    void forEachPrefix( string_view prefix, Function f ) const; // keys starting with prefix, sorted
+
+    MemoryReport memoryUsage( ) const;
+    void countNodes( size_t counts[ 5 ] ) const; // number of nodes of each ArtNodeType
+
+  private:
+
+    typedef ArtLeaf<value> Leaf;
+
+    ArtHeader * root;
+    size_t count;
+
+    static unsigned char keyByte( string_view key, size_t depth ) { return depth < key.size( ) ? key[ depth ] : 0; }
+    static bool isLeaf( const ArtHeader * n ) { return n->type == ART_LEAF; }
+    static Leaf * asLeaf( ArtHeader * n ) { return static_cast<Leaf *>( n ); }
+    static const Leaf * asLeaf( const ArtHeader * n ) { return static_cast<const Leaf *>( n ); }
+
+    static ArtHeader ** findChild( ArtNode * n, unsigned char c );
+    static const Leaf * minimum( const ArtHeader * n );
+    static size_t checkPrefix( const ArtNode * n, string_view key, size_t keyLength, size_t depth );
+    static size_t prefixMismatch( const ArtNode * n, string_view key, size_t keyLength, size_t depth );
+    static size_t longestCommonPrefix( const Leaf * l1, const Leaf * l2, size_t depth );
+
+    static void addChild( ArtNode * n, ArtHeader ** ref, unsigned char c, ArtHeader * child );
+    static void addChild4( ArtNode4 * n, ArtHeader ** ref, unsigned char c, ArtHeader * child );
+    static void addChild16( ArtNode16 * n, ArtHeader ** ref, unsigned char c, ArtHeader * child );
+    static void addChild48( ArtNode48 * n, ArtHeader ** ref, unsigned char c, ArtHeader * child );
+    static void addChild256( ArtNode256 * n, unsigned char c, ArtHeader * child );
+    static void removeChild( ArtNode * n, ArtHeader ** ref, unsigned char c, ArtHeader ** slot );
+    static void copyHeader( ArtNode * dest, const ArtNode * src );
+
+    template <class V>
+    Leaf * insert( ArtHeader ** ref, string_view key, V && details, size_t depth, bool & added );
+    template <class V>
+    static Leaf * makeLeaf( string_view key, V && details );
+    Leaf * remove( ArtHeader ** ref, string_view key, size_t depth );
+    void makeEmpty( ArtHeader * n );
+    template <class Function>
+    static void forEach( const ArtHeader * n, Function & f );
+    void memoryUsage( const ArtHeader * n, MemoryReport & report ) const;
+    static void countNodes( const ArtHeader * n, size_t counts[ 5 ] );
+
+    AdaptiveRadixTree( const AdaptiveRadixTree & ) = delete;
+    const AdaptiveRadixTree & operator=( const AdaptiveRadixTree & ) = delete;
+};
+
+/**
+ * Return the slot holding the child for byte c, or nullptr.
+ */
+template <class value>
+ArtHeader ** AdaptiveRadixTree<value>::findChild( ArtNode * n, unsigned char c )
+{
+    switch ( n->type )
+    {
+        case ART_NODE4:
+        {
+            ArtNode4 * p = static_cast<ArtNode4 *>( n );
+            for ( int i = 0; i < n->numChildren; i++ )
+                if ( p->keys[ i ] == c )
+                    return &p->children[ i ];
+            return nullptr;
+        }
+        case ART_NODE16:
+        {
+            ArtNode16 * p = static_cast<ArtNode16 *>( n );
+#ifdef __SSE2__
+            // Compare c against all 16 keys at once
+            __m128i cmp = _mm_cmpeq_epi8( _mm_set1_epi8( (char) c ), _mm_loadu_si128( (const __m128i *) p->keys ) );
+            int bits = _mm_movemask_epi8( cmp ) & ( ( 1 << n->numChildren ) - 1 );
+            return bits ? &p->children[ __builtin_ctz( bits ) ] : nullptr;
+#else
+            for ( int i = 0; i < n->numChildren; i++ )
+                if ( p->keys[ i ] == c )
+                    return &p->children[ i ];
+            return nullptr;
+#endif
+        }
+        case ART_NODE48:
+        {
+            ArtNode48 * p = static_cast<ArtNode48 *>( n );
+            int i = p->childIndex[ c ];
+            return i ? &p->children[ i - 1 ] : nullptr;
+        }
+        default:
+        {
+            ArtNode256 * p = static_cast<ArtNode256 *>( n );
+            return p->children[ c ] ? &p->children[ c ] : nullptr;
+        }
+    }
+}
+
+/**
+ * Leftmost (smallest) leaf below n.
+ */
+template <class value>
+const ArtLeaf<value> * AdaptiveRadixTree<value>::minimum( const ArtHeader * n )
+{
+    while ( n != nullptr && !isLeaf( n ) )
+    {
+        switch ( n->type )
+        {
+            case ART_NODE4:
+                n = static_cast<const ArtNode4 *>( n )->children[ 0 ];
+                break;
+            case ART_NODE16:
+                n = static_cast<const ArtNode16 *>( n )->children[ 0 ];
+                break;
+            case ART_NODE48:
+            {
+                const ArtNode48 * p = static_cast<const ArtNode48 *>( n );
+                int c = 0;
+                while ( !p->childIndex[ c ] )
+                    c++;
+                n = p->children[ p->childIndex[ c ] - 1 ];
+                break;
+            }
+            default:
+            {
+                const ArtNode256 * p = static_cast<const ArtNode256 *>( n );
+                int c = 0;
+                while ( !p->children[ c ] )
+                    c++;
+                n = p->children[ c ];
+            }
+        }
+    }
+    return n == nullptr ? nullptr : asLeaf( n );
+}
+
+/**
+ * Number of stored prefix bytes of n that match key at depth.
+ */
+template <class value>
+size_t AdaptiveRadixTree<value>::checkPrefix( const ArtNode * n, string_view key, size_t keyLength, size_t depth )
+{
+    size_t maxCompare = min( min<size_t>( n->prefixLength, ART_MAX_PREFIX ), keyLength - depth );
+    size_t idx;
+    for ( idx = 0; idx < maxCompare; idx++ )
+        if ( n->prefix[ idx ] != keyByte( key, depth + idx ) )
+            return idx;
+    return idx;
+}
+
+/**
+ * Length of the match between the full compressed path of n and key at
+ * depth. Bytes beyond ART_MAX_PREFIX are read from the minimum leaf.
+ */
+template <class value>
+size_t AdaptiveRadixTree<value>::prefixMismatch( const ArtNode * n, string_view key, size_t keyLength, size_t depth )
+{
+    size_t idx = checkPrefix( n, key, keyLength, depth );
+    if ( idx < ART_MAX_PREFIX || n->prefixLength <= ART_MAX_PREFIX )
+        return idx;
+
+    const Leaf * l = minimum( n );
+    size_t maxCompare = min( l->key.size( ) + 1, keyLength ) - depth;
+    for ( ; idx < maxCompare; idx++ )
+        if ( keyByte( l->key, depth + idx ) != keyByte( key, depth + idx ) )
+            return idx;
+    return idx;
+}
+
+template <class value>
+size_t AdaptiveRadixTree<value>::longestCommonPrefix( const Leaf * l1, const Leaf * l2, size_t depth )
+{
+    size_t maxCompare = min( l1->key.size( ), l2->key.size( ) ) + 1 - depth;
+    size_t idx;
+    for ( idx = 0; idx < maxCompare; idx++ )
+        if ( keyByte( l1->key, depth + idx ) != keyByte( l2->key, depth + idx ) )
+            return idx;
+    return idx;
+}
+
+template <class value>
+void AdaptiveRadixTree<value>::copyHeader( ArtNode * dest, const ArtNode * src )
+{
+    dest->numChildren = src->numChildren;
+    dest->prefixLength = src->prefixLength;
+    memcpy( dest->prefix, src->prefix, min<size_t>( src->prefixLength, ART_MAX_PREFIX ) );
+}
+
+template <class value>
+void AdaptiveRadixTree<value>::addChild256( ArtNode256 * n, unsigned char c, ArtHeader * child )
+{
+    n->numChildren++;
+    n->children[ c ] = child;
+}
+
+template <class value>
+void AdaptiveRadixTree<value>::addChild48( ArtNode48 * n, ArtHeader ** ref, unsigned char c, ArtHeader * child )
+{
+    if ( n->numChildren < 48 )
+    {
+        int pos = 0;
+        while ( n->children[ pos ] )
+            pos++;
+        n->children[ pos ] = child;
+        n->childIndex[ c ] = pos + 1;
+        n->numChildren++;
+        return;
+    }
+    ArtNode256 * grown = new ArtNode256( );
+    grown->type = ART_NODE256;
+    for ( int i = 0; i < 256; i++ )
+        if ( n->childIndex[ i ] )
+            grown->children[ i ] = n->children[ n->childIndex[ i ] - 1 ];
+    copyHeader( grown, n );
+    *ref = grown;
+    delete n;
+    addChild256( grown, c, child );
+}
+
+template <class value>
+void AdaptiveRadixTree<value>::addChild16( ArtNode16 * n, ArtHeader ** ref, unsigned char c, ArtHeader * child )
+{
+    if ( n->numChildren < 16 )
+    {
+        int idx = 0;
+        while ( idx < n->numChildren && n->keys[ idx ] < c )
+            idx++;
+        memmove( n->keys + idx + 1, n->keys + idx, n->numChildren - idx );
+        memmove( n->children + idx + 1, n->children + idx, ( n->numChildren - idx ) * sizeof( ArtHeader * ) );
+        n->keys[ idx ] = c;
+        n->children[ idx ] = child;
+        n->numChildren++;
+        return;
+    }
+    ArtNode48 * grown = new ArtNode48( );
+    grown->type = ART_NODE48;
+    memcpy( grown->children, n->children, sizeof( n->children ) );
+    for ( int i = 0; i < n->numChildren; i++ )
+        grown->childIndex[ n->keys[ i ] ] = i + 1;
+    copyHeader( grown, n );
+    *ref = grown;
+    delete n;
+    addChild48( grown, ref, c, child );
+}
+
+template <class value>
+void AdaptiveRadixTree<value>::addChild4( ArtNode4 * n, ArtHeader ** ref, unsigned char c, ArtHeader * child )
+{
+    if ( n->numChildren < 4 )
+    {
+        int idx = 0;
+        while ( idx < n->numChildren && n->keys[ idx ] < c )
+            idx++;
+        memmove( n->keys + idx + 1, n->keys + idx, n->numChildren - idx );
+        memmove( n->children + idx + 1, n->children + idx, ( n->numChildren - idx ) * sizeof( ArtHeader * ) );
+        n->keys[ idx ] = c;
+        n->children[ idx ] = child;
+        n->numChildren++;
+        return;
+    }
+    ArtNode16 * grown = new ArtNode16( );
+    grown->type = ART_NODE16;
+    memcpy( grown->children, n->children, sizeof( n->children ) );
+    memcpy( grown->keys, n->keys, sizeof( n->keys ) );
+    copyHeader( grown, n );
+    *ref = grown;
+    delete n;
+    addChild16( grown, ref, c, child );
+}
+
+template <class value>
+void AdaptiveRadixTree<value>::addChild( ArtNode * n, ArtHeader ** ref, unsigned char c, ArtHeader * child )
+{
+    switch ( n->type )
+    {
+        case ART_NODE4:
+            addChild4( static_cast<ArtNode4 *>( n ), ref, c, child );
+            break;
+        case ART_NODE16:
+            addChild16( static_cast<ArtNode16 *>( n ), ref, c, child );
+            break;
+        case ART_NODE48:
+            addChild48( static_cast<ArtNode48 *>( n ), ref, c, child );
+            break;
+        default:
+            addChild256( static_cast<ArtNode256 *>( n ), c, child );
+    }
+}
+
+/**
+ * Remove the child in slot (reached through byte c) and shrink n
+ * to a smaller layout when it becomes sparse enough.
+ */
+template <class value>
+void AdaptiveRadixTree<value>::removeChild( ArtNode * n, ArtHeader ** ref, unsigned char c, ArtHeader ** slot )
+{
+    switch ( n->type )
+    {
+        case ART_NODE4:
+        {
+            ArtNode4 * p = static_cast<ArtNode4 *>( n );
+            int pos = int( slot - p->children );
+            memmove( p->keys + pos, p->keys + pos + 1, p->numChildren - 1 - pos );
+            memmove( p->children + pos, p->children + pos + 1, ( p->numChildren - 1 - pos ) * sizeof( ArtHeader * ) );
+            p->numChildren--;
+
+            // A Node4 with one child is merged into that child
+            if ( p->numChildren == 1 )
+            {
+                ArtHeader * child = p->children[ 0 ];
+                if ( !isLeaf( child ) )
+                {
+                    ArtNode * inner = static_cast<ArtNode *>( child );
+                    unsigned char path[ ART_MAX_PREFIX ];
+                    size_t length = min<size_t>( p->prefixLength, ART_MAX_PREFIX );
+                    memcpy( path, p->prefix, length );
+                    if ( length < ART_MAX_PREFIX )
+                        path[ length++ ] = p->keys[ 0 ];
+                    if ( length < ART_MAX_PREFIX )
+                    {
+                        size_t more = min<size_t>( inner->prefixLength, ART_MAX_PREFIX - length );
+                        memcpy( path + length, inner->prefix, more );
+                        length += more;
+                    }
+                    memcpy( inner->prefix, path, min<size_t>( length, ART_MAX_PREFIX ) );
+                    inner->prefixLength += p->prefixLength + 1;
+                }
+                *ref = child;
+                delete p;
+            }
+            break;
+        }
+        case ART_NODE16:
+        {
+            ArtNode16 * p = static_cast<ArtNode16 *>( n );
+            int pos = int( slot - p->children );
+            memmove( p->keys + pos, p->keys + pos + 1, p->numChildren - 1 - pos );
+            memmove( p->children + pos, p->children + pos + 1, ( p->numChildren - 1 - pos ) * sizeof( ArtHeader * ) );
+            p->numChildren--;
+
+            if ( p->numChildren == 3 )
+            {
+                ArtNode4 * shrunk = new ArtNode4( );
+                shrunk->type = ART_NODE4;
+                copyHeader( shrunk, p );
+                memcpy( shrunk->keys, p->keys, 3 );
+                memcpy( shrunk->children, p->children, 3 * sizeof( ArtHeader * ) );
+                *ref = shrunk;
+                delete p;
+            }
+            break;
+        }
+        case ART_NODE48:
+        {
+            ArtNode48 * p = static_cast<ArtNode48 *>( n );
+            int pos = p->childIndex[ c ];
+            p->childIndex[ c ] = 0;
+            p->children[ pos - 1 ] = nullptr;
+            p->numChildren--;
+
+            if ( p->numChildren == 12 )
+            {
+                ArtNode16 * shrunk = new ArtNode16( );
+                shrunk->type = ART_NODE16;
+                copyHeader( shrunk, p );
+                int child = 0;
+                for ( int i = 0; i < 256; i++ )
+                {
+                    if ( p->childIndex[ i ] )
+                    {
+                        shrunk->keys[ child ] = (unsigned char) i;
+                        shrunk->children[ child ] = p->children[ p->childIndex[ i ] - 1 ];
+                        child++;
+                    }
+                }
+                *ref = shrunk;
+                delete p;
+            }
+            break;
+        }
+        default:
+        {
+            ArtNode256 * p = static_cast<ArtNode256 *>( n );
+            p->children[ c ] = nullptr;
+            p->numChildren--;
+
+            if ( p->numChildren == 37 )
+            {
+                ArtNode48 * shrunk = new ArtNode48( );
+                shrunk->type = ART_NODE48;
+                copyHeader( shrunk, p );
+                int pos = 0;
+                for ( int i = 0; i < 256; i++ )
+                {
+                    if ( p->children[ i ] )
+                    {
+                        shrunk->children[ pos ] = p->children[ i ];
+                        shrunk->childIndex[ i ] = pos + 1;
+                        pos++;
+                    }
+                }
+                *ref = shrunk;
+                delete p;
+            }
+        }
+    }
+}
+
+// Find the details of key, nullptr if absent
+template <class value>
+value * AdaptiveRadixTree<value>::find( string_view key )
+{
+    return const_cast<value *>( static_cast<const AdaptiveRadixTree *>( this )->find( key ) );
+}
+
+template <class value>
+const value * AdaptiveRadixTree<value>::find( string_view key ) const
+{
+    const ArtHeader * n = root;
+    size_t depth = 0, keyLength = key.size( ) + 1;
+    while ( n != nullptr )
+    {
+        if ( isLeaf( n ) )
+        {
+            const Leaf * l = asLeaf( n );
+            return l->key == key ? &l->details : nullptr;
+        }
+        const ArtNode * inner = static_cast<const ArtNode *>( n );
+        if ( inner->prefixLength )
+        {
+            // Optimistic: only the stored bytes are checked, the leaf compare catches the rest
+            if ( checkPrefix( inner, key, keyLength, depth ) != min<size_t>( inner->prefixLength, ART_MAX_PREFIX ) )
+                return nullptr;
+            depth += inner->prefixLength;
+        }
+        if ( depth >= keyLength )
+            return nullptr;
+        ArtHeader ** child = findChild( const_cast<ArtNode *>( inner ), keyByte( key, depth ) );
+        n = child == nullptr ? nullptr : *child;
+        depth++;
+    }
+    return nullptr;
+}
+
+// Insert key with its details; nothing changes if the key is already present
+template <class value>
+bool AdaptiveRadixTree<value>::insert( string_view key, const value & details )
+{
+    bool added = false;
+    insert( &root, key, details, 0, added );
+    if ( added )
+        count++;
+    return added;
+}
+
+// Insert key, moving the details into the new leaf
+template <class value>
+bool AdaptiveRadixTree<value>::insert( string_view key, value && details )
+{
+    bool added = false;
+    insert( &root, key, std::move( details ), 0, added );
+    if ( added )
+        count++;
+    return added;
+}
+
+// Replace the details of key, inserting it if needed
+template <class value>
+void AdaptiveRadixTree<value>::update( string_view key, const value & details )
+{
+    update( key, value( details ) );
+}
+
+template <class value>
+void AdaptiveRadixTree<value>::update( string_view key, value && details )
+{
+    bool added = false;
+    Leaf * l = insert( &root, key, std::move( details ), 0, added );
+    if ( added )
+        count++;
+    else
+        l->details = std::move( details );    // not consumed when the key was present
+}
+
+template <class value>
+template <class V>
+ArtLeaf<value> * AdaptiveRadixTree<value>::makeLeaf( string_view key, V && details )
+{
+    Leaf * l = new Leaf( );
+    l->type = ART_LEAF;
+    l->key = key;
+    l->details = std::forward<V>( details );
+    return l;
+}
+
+/**
+ * Internal method to insert below *ref. Returns the leaf holding key.
+ */
+template <class value>
+template <class V>
+ArtLeaf<value> * AdaptiveRadixTree<value>::insert( ArtHeader ** ref, string_view key, V && details,
+                                                   size_t depth, bool & added )
+{
+    ArtHeader * n = *ref;
+    if ( n == nullptr )
+    {
+        Leaf * l = makeLeaf( key, std::forward<V>( details ) );
+        *ref = l;
+        added = true;
+        return l;
+    }
+
+    // Splitting a leaf: both keys go below a new Node4 holding their common path
+    if ( isLeaf( n ) )
+    {
+        Leaf * existing = asLeaf( n );
+        if ( existing->key == key )
+            return existing;
+
+        Leaf * l = makeLeaf( key, std::forward<V>( details ) );
+        added = true;
+
+        ArtNode4 * split = new ArtNode4( );
+        split->type = ART_NODE4;
+        size_t common = longestCommonPrefix( existing, l, depth );
+        split->prefixLength = uint32_t( common );
+        for ( size_t i = 0; i < min<size_t>( common, ART_MAX_PREFIX ); i++ )
+            split->prefix[ i ] = keyByte( key, depth + i );
+        *ref = split;
+        addChild4( split, ref, keyByte( existing->key, depth + common ), existing );
+        addChild4( split, ref, keyByte( key, depth + common ), l );
+        return l;
+    }
+
+    ArtNode * inner = static_cast<ArtNode *>( n );
+    size_t keyLength = key.size( ) + 1;
+    if ( inner->prefixLength )
+    {
+        size_t diff = prefixMismatch( inner, key, keyLength, depth );
+        if ( diff < inner->prefixLength )
+        {
+            // The key leaves the compressed path: split the path at diff
+            ArtNode4 * split = new ArtNode4( );
+            split->type = ART_NODE4;
+            split->prefixLength = uint32_t( diff );
+            memcpy( split->prefix, inner->prefix, min<size_t>( diff, ART_MAX_PREFIX ) );
+            *ref = split;
+
+            if ( inner->prefixLength <= ART_MAX_PREFIX )
+            {
+                addChild4( split, ref, inner->prefix[ diff ], inner );
+                inner->prefixLength -= uint32_t( diff + 1 );
+                memmove( inner->prefix, inner->prefix + diff + 1, min<size_t>( inner->prefixLength, ART_MAX_PREFIX ) );
+            }
+            else
+            {
+                inner->prefixLength -= uint32_t( diff + 1 );
+                const Leaf * l = minimum( inner );
+                addChild4( split, ref, keyByte( l->key, depth + diff ), inner );
+                for ( size_t i = 0; i < min<size_t>( inner->prefixLength, ART_MAX_PREFIX ); i++ )
+                    inner->prefix[ i ] = keyByte( l->key, depth + diff + 1 + i );
+            }
+
+            Leaf * l = makeLeaf( key, std::forward<V>( details ) );
+            added = true;
+            addChild4( split, ref, keyByte( key, depth + diff ), l );
+            return l;
+        }
+        depth += inner->prefixLength;
+    }
+
+    ArtHeader ** child = findChild( inner, keyByte( key, depth ) );
+    if ( child != nullptr )
+        return insert( child, key, std::forward<V>( details ), depth + 1, added );
+
+    Leaf * l = makeLeaf( key, std::forward<V>( details ) );
+    added = true;
+    addChild( inner, ref, keyByte( key, depth ), l );
+    return l;
+}
+
+// Remove key from the tree
+template <class value>
+bool AdaptiveRadixTree<value>::remove( string_view key )
+{
+    Leaf * l = remove( &root, key, 0 );
+    if ( l == nullptr )
+        return false;
+    delete l;
+    count--;
+    return true;
+}
+
+/**
+ * Internal method to unlink the leaf of key below *ref.
+ * Returns the unlinked leaf, or nullptr if the key is absent.
+ */
+template <class value>
+ArtLeaf<value> * AdaptiveRadixTree<value>::remove( ArtHeader ** ref, string_view key, size_t depth )
+{
+    ArtHeader * n = *ref;
+    if ( n == nullptr )
+        return nullptr;
+    if ( isLeaf( n ) )
+    {
+        if ( asLeaf( n )->key != key )
+            return nullptr;
+        *ref = nullptr;
+        return asLeaf( n );
+    }
+
+    ArtNode * inner = static_cast<ArtNode *>( n );
+    size_t keyLength = key.size( ) + 1;
+    if ( inner->prefixLength )
+    {
+        if ( checkPrefix( inner, key, keyLength, depth ) != min<size_t>( inner->prefixLength, ART_MAX_PREFIX ) )
+            return nullptr;
+        depth += inner->prefixLength;
+    }
+    if ( depth >= keyLength )
+        return nullptr;
+
+    unsigned char c = keyByte( key, depth );
+    ArtHeader ** child = findChild( inner, c );
+    if ( child == nullptr )
+        return nullptr;
+
+    if ( isLeaf( *child ) )
+    {
+        Leaf * l = asLeaf( *child );
+        if ( l->key != key )
+            return nullptr;
+        removeChild( inner, ref, c, child );
+        return l;
+    }
+    return remove( child, key, depth + 1 );
+}
+
+template <class value>
+void AdaptiveRadixTree<value>::makeEmpty( )
+{
+    makeEmpty( root );
+    root = nullptr;
+    count = 0;
+}
+
+template <class value>
+void AdaptiveRadixTree<value>::makeEmpty( ArtHeader * n )
+{
+    if ( n == nullptr )
+        return;
+    switch ( n->type )
+    {
+        case ART_LEAF:
+            delete asLeaf( n );
+            return;
+        case ART_NODE4:
+        {
+            ArtNode4 * p = static_cast<ArtNode4 *>( n );
+            for ( int i = 0; i < p->numChildren; i++ )
+                makeEmpty( p->children[ i ] );
+            delete p;
+            return;
+        }
+        case ART_NODE16:
+        {
+            ArtNode16 * p = static_cast<ArtNode16 *>( n );
+            for ( int i = 0; i < p->numChildren; i++ )
+                makeEmpty( p->children[ i ] );
+            delete p;
+            return;
+        }
+        case ART_NODE48:
+        {
+            ArtNode48 * p = static_cast<ArtNode48 *>( n );
+            for ( int i = 0; i < 48; i++ )
+                makeEmpty( p->children[ i ] );
+            delete p;
+            return;
+        }
+        default:
+        {
+            ArtNode256 * p = static_cast<ArtNode256 *>( n );
+            for ( int i = 0; i < 256; i++ )
+                makeEmpty( p->children[ i ] );
+            delete p;
+        }
+    }
+}
+
+template <class value>
+template <class Function>
+void AdaptiveRadixTree<value>::forEach( Function f ) const
+{
+    forEach( root, f );
+}
+
+// Internal method to visit the leaves below n in key order
+template <class value>
+template <class Function>
+void AdaptiveRadixTree<value>::forEach( const ArtHeader * n, Function & f )
+{
+    if ( n == nullptr )
+        return;
+    switch ( n->type )
+    {
+        case ART_LEAF:
+            f( asLeaf( n )->key, asLeaf( n )->details );
+            return;
+        case ART_NODE4:
+        {
+            const ArtNode4 * p = static_cast<const ArtNode4 *>( n );
+            for ( int i = 0; i < p->numChildren; i++ )
+                forEach( p->children[ i ], f );
+            return;
+        }
+        case ART_NODE16:
+        {
+            const ArtNode16 * p = static_cast<const ArtNode16 *>( n );
+            for ( int i = 0; i < p->numChildren; i++ )
+                forEach( p->children[ i ], f );
+            return;
+        }
+        case ART_NODE48:
+        {
+            const ArtNode48 * p = static_cast<const ArtNode48 *>( n );
+            for ( int i = 0; i < 256; i++ )
+                if ( p->childIndex[ i ] )
+                    forEach( p->children[ p->childIndex[ i ] - 1 ], f );
+            return;
+        }
+        default:
+        {
+            const ArtNode256 * p = static_cast<const ArtNode256 *>( n );
+            for ( int i = 0; i < 256; i++ )
+                forEach( p->children[ i ], f );
+        }
+    }
+}
+
+/**
+ * Visit every key that starts with prefix, in sorted order.
+ * Descends to the subtree that covers the prefix and walks only that.
+ */
+template <class value>
+template <class Function>
+void AdaptiveRadixTree<value>::forEachPrefix( string_view prefix, Function f ) const
+{
+    const ArtHeader * n = root;
+    size_t depth = 0, prefixLength = prefix.size( );
+    while ( n != nullptr )
+    {
+        if ( isLeaf( n ) )
+        {
+            const Leaf * l = asLeaf( n );
+            if ( l->key.compare( 0, prefixLength, prefix ) == 0 )
+                f( l->key, l->details );
+            return;
+        }
+        if ( depth == prefixLength )
+        {
+            forEach( n, f );
+            return;
+        }
+
+        const ArtNode * inner = static_cast<const ArtNode *>( n );
+        if ( inner->prefixLength )
+        {
+            size_t matched = prefixMismatch( inner, prefix, prefixLength, depth );
+            if ( depth + matched == prefixLength )
+            {
+                // The prefix ends inside the compressed path; the whole subtree matches
+                forEach( n, f );
+                return;
+            }
+            if ( matched < inner->prefixLength )
+                return;
+            depth += inner->prefixLength;
+        }
+
+        ArtHeader ** child = findChild( const_cast<ArtNode *>( inner ), keyByte( prefix, depth ) );
+        n = child == nullptr ? nullptr : *child;
+        depth++;
+    }
+}
+
+template <class value>
+MemoryReport AdaptiveRadixTree<value>::memoryUsage( ) const
+{
+    MemoryReport report;
+    memoryUsage( root, report );
+    return report;
+}
+
+// Internal method to account the subtree below n
+template <class value>
+void AdaptiveRadixTree<value>::memoryUsage( const ArtHeader * n, MemoryReport & report ) const
+{
+    if ( n == nullptr )
+        return;
+    size_t bytes = 0;
+    switch ( n->type )
+    {
+        case ART_LEAF:
+        {
+            const Leaf * l = asLeaf( n );
+            report.nodeBytes += sizeof( Leaf );
+            addAllocation( report, sizeof( Leaf ) );
+            accountMemory( l->details, report );
+            return;
+        }
+        case ART_NODE4:
+            bytes = sizeof( ArtNode4 );
+            break;
+        case ART_NODE16:
+            bytes = sizeof( ArtNode16 );
+            break;
+        case ART_NODE48:
+            bytes = sizeof( ArtNode48 );
+            break;
+        default:
+            bytes = sizeof( ArtNode256 );
+    }
+    report.nodeBytes += bytes;
+    addAllocation( report, bytes );
+    switch ( n->type )
+    {
+        case ART_NODE4:
+            for ( int i = 0; i < static_cast<const ArtNode4 *>( n )->numChildren; i++ )
+                memoryUsage( static_cast<const ArtNode4 *>( n )->children[ i ], report );
+            break;
+        case ART_NODE16:
+            for ( int i = 0; i < static_cast<const ArtNode16 *>( n )->numChildren; i++ )
+                memoryUsage( static_cast<const ArtNode16 *>( n )->children[ i ], report );
+            break;
+        case ART_NODE48:
+            for ( int i = 0; i < 48; i++ )
+                memoryUsage( static_cast<const ArtNode48 *>( n )->children[ i ], report );
+            break;
+        default:
+            for ( int i = 0; i < 256; i++ )
+                memoryUsage( static_cast<const ArtNode256 *>( n )->children[ i ], report );
+    }
+}
+
+template <class value>
+void AdaptiveRadixTree<value>::countNodes( size_t counts[ 5 ] ) const
+{
+    for ( int i = 0; i < 5; i++ )
+        counts[ i ] = 0;
+    countNodes( root, counts );
+}
+
+template <class value>
+void AdaptiveRadixTree<value>::countNodes( const ArtHeader * n, size_t counts[ 5 ] )
+{
+    if ( n == nullptr )
+        return;
+    counts[ n->type ]++;
+    switch ( n->type )
+    {
+        case ART_NODE4:
+            for ( int i = 0; i < static_cast<const ArtNode4 *>( n )->numChildren; i++ )
+                countNodes( static_cast<const ArtNode4 *>( n )->children[ i ], counts );
+            break;
+        case ART_NODE16:
+            for ( int i = 0; i < static_cast<const ArtNode16 *>( n )->numChildren; i++ )
+                countNodes( static_cast<const ArtNode16 *>( n )->children[ i ], counts );
+            break;
+        case ART_NODE48:
+            for ( int i = 0; i < 48; i++ )
+                countNodes( static_cast<const ArtNode48 *>( n )->children[ i ], counts );
+            break;
+        case ART_NODE256:
+            for ( int i = 0; i < 256; i++ )
+                countNodes( static_cast<const ArtNode256 *>( n )->children[ i ], counts );
+            break;
+    }
+}
+
+#endif /* ART_h */
@@ -0,0 +1,280 @@
+#ifndef Backend_h
+#define Backend_h
+
+#include <string>
+#include <string_view>
+#include <sstream>
+#include <vector>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+#include "BST.h"
+#include "HASH.h"
+#include "ART.h"
+#include "SWISS.h"
+#include "INDEX.h"
+#include "MEMORY.h"
+
+using namespace std;
+
+// A dictionary backend maps a word to its WordItem. Backends are plain
+// classes, bound at compile time through SearchIndex<Backend>, so no call
+// on the ingestion or query path is virtual. Every backend provides:
+//
+//   static const char * name();
+//   WordItem * find(string_view word);                 // nullptr if absent
+//   const WordItem * find(string_view word) const;     // must be safe to call concurrently
+//   void insert(string_view word, const WordItem & item);
+//   void insert(string_view word, WordItem && item);   // moves the postings in
+//   void remove(string_view word);
+//   int size() const;                                  // number of words
+//   MemoryReport memoryUsage() const;
+//   string summary() const;                            // structure specific facts for reports
+//   template <class Function> void forEach(Function f) const;  // f(word, item) for every word
+//
+// Backends key on the view passed to insert() and do not copy the word:
+// SearchIndex passes views of the shared TermPool, which outlives them.
+// A pointer returned by find() stays valid until the next insert or remove.
+// To compare a new structure, write an adapter with this interface and add
+// it to the Backends list in main.cpp.
+
+// Weight of a word item in the AVL tree's subtree totals: its occurrences
+// in all documents, so AvlTree::rangeSum adds up term frequencies
+struct WordWeight {
+
+    long long operator()( const WordItem & item ) const
+    {
+        long long occurrences = 0;
+        for ( size_t i = 0; i < item.documents.size( ); i++ )
+            occurrences += item.documents.count( i );
+        return occurrences;
+    }
+};
+
+// Adapter for the AVL tree
+class AvlBackend
+{
+  public:
+
+    AvlBackend( ) : tree( "not found" ), words( 0 ) { }
+
+    static const char * name( ) { return "BST"; }
+
+    WordItem * find( string_view word ) { return tree.findValue( word ); }
+    const WordItem * find( string_view word ) const { return tree.findValue( word ); }
+
+    void insert( string_view word, const WordItem & item )
+    {
+        tree.insert( word, item );
+        words++;
+    }
+
+    void insert( string_view word, WordItem && item )
+    {
+        tree.emplace( word, std::move( item ) );
+        words++;
+    }
+
+    void remove( string_view word )
+    {
+        if ( tree.findValue( word ) == nullptr )
+            return;
+        tree.remove( word );
+        words--;
+    }
+
+    int size( ) const { return words; }
+    MemoryReport memoryUsage( ) const { return tree.memoryUsage( ); }
+    string summary( ) const { return ""; }
+
+    template <class Function>
+    void forEach( Function f ) const { tree.forEach( f ); }    // f(word, item) in sorted order
+
+    // The posting lists are attached in place once ingestion ends, so the
+    // occurrence totals behind AvlTree::rangeSum are measured again then
+    void finalize( ) { tree.reweighAll( ); }
+
+    // Replace the contents with sorted, distinct words in O(n), no rotations
+    void bulkLoad( vector<pair<string_view, WordItem>> & items )
+    {
+        tree.bulkLoad( make_move_iterator( items.begin( ) ), make_move_iterator( items.end( ) ) );
+        words = int( items.size( ) );
+    }
+
+    AvlTree<string_view, WordItem, WordWeight> & structure( ) { return tree; }
+    const AvlTree<string_view, WordItem, WordWeight> & structure( ) const { return tree; }
+
+  private:
+
+    AvlTree<string_view, WordItem, WordWeight> tree;
+    int words;
+};
+
+// Adapter for the quadratic probing hash table
+class HashBackend
+{
+  public:
+
+    HashBackend( ) : table( "not found" ), words( 0 ) { }
+
+    static const char * name( ) { return "HASH"; }
+
+    WordItem * find( string_view word ) { return table.findValue( word ); }
+    const WordItem * find( string_view word ) const { return table.findValue( word ); }
+
+    void insert( string_view word, const WordItem & item )
+    {
+        table.insert( word, item );
+        words++;
+    }
+
+    void insert( string_view word, WordItem && item )
+    {
+        table.emplace( word, std::move( item ) );
+        words++;
+    }
+
+    void remove( string_view word )
+    {
+        if ( table.findValue( word ) == nullptr )
+            return;
+        table.remove( word );
+        words--;
+    }
+
+    int size( ) const { return words; }
+    MemoryReport memoryUsage( ) const { return table.memoryUsage( ); }
+
+    string summary( ) const
+    {
+        HashTableStats stats = table.stats( );
+        ostringstream text;
+        text << "load ratio " << stats.loadFactor << ", " << stats.tableSize << " slots";
+        if ( stats.rehashes > 0 )
+            text << ", " << stats.rehashes << " rehashes in " << stats.rehashNanos / 1e6 << " ms";
+        return text.str( );
+    }
+
+    template <class Function>
+    void forEach( Function f ) const { table.forEach( f ); }    // f(word, item) in table order
+
+    HashTable<string_view, WordItem> & structure( ) { return table; }
+
+  private:
+
+    HashTable<string_view, WordItem> table;
+    int words;
+};
+
+// Adapter for the Swiss table
+class SwissBackend
+{
+  public:
+
+    static const char * name( ) { return "SWISS"; }
+
+    WordItem * find( string_view word ) { return table.findValue( word ); }
+    const WordItem * find( string_view word ) const { return table.findValue( word ); }
+    void insert( string_view word, const WordItem & item ) { table.insert( word, item ); }
+    void insert( string_view word, WordItem && item ) { table.emplace( word, std::move( item ) ); }
+    void remove( string_view word ) { table.remove( word ); }
+
+    int size( ) const { return int( table.size( ) ); }
+    MemoryReport memoryUsage( ) const { return table.memoryUsage( ); }
+
+    string summary( ) const
+    {
+        ostringstream text;
+        text << "load ratio " << table.loadFactor( ) << ", " << table.capacity( ) << " slots, "
+             << table.tombstones( ) << " tombstones";
+        return text.str( );
+    }
+
+    template <class Function>
+    void forEach( Function f ) const { table.forEach( f ); }    // f(word, item) in table order
+
+    SwissTable<string_view, WordItem> & structure( ) { return table; }
+
+  private:
+
+    SwissTable<string_view, WordItem> table;
+};
+
+// Adapter for the adaptive radix tree
+class ArtBackend
+{
+  public:
+
+    static const char * name( ) { return "ART"; }
+
+    WordItem * find( string_view word ) { return tree.find( word ); }
+    const WordItem * find( string_view word ) const { return tree.find( word ); }
+    void insert( string_view word, const WordItem & item ) { tree.insert( word, item ); }
+    void insert( string_view word, WordItem && item ) { tree.insert( word, std::move( item ) ); }
+    void remove( string_view word ) { tree.remove( word ); }
+
+    int size( ) const { return int( tree.size( ) ); }
+    MemoryReport memoryUsage( ) const { return tree.memoryUsage( ); }
+
+    string summary( ) const
+    {
+        size_t counts[ 5 ];
+        tree.countNodes( counts );
+        ostringstream text;
+        text << "Node4/16/48/256 " << counts[ ART_NODE4 ] << "/" << counts[ ART_NODE16 ] << "/"
+             << counts[ ART_NODE48 ] << "/" << counts[ ART_NODE256 ];
+        return text.str( );
+    }
+
+    template <class Function>
+    void forEach( Function f ) const { tree.forEach( f ); }    // f(word, item) in sorted order
+
+    template <class Function>
+    void forEachPrefix( string_view prefix, Function f ) const { tree.forEachPrefix( prefix, f ); }
+
+    AdaptiveRadixTree<WordItem> & structure( ) { return tree; }
+
+  private:
+
+    AdaptiveRadixTree<WordItem> tree;
+};
+
+// Compile-time check that a class provides the backend interface
+template <class Backend>
+struct BackendInterface {
+
+    static_assert(is_same<decltype(declval<Backend &>().find(declval<string_view>())), WordItem *>::value,
+                  "Backend::find(word) must return WordItem *");
+    static_assert(is_same<decltype(declval<const Backend &>().find(declval<string_view>())), const WordItem *>::value,
+                  "Backend::find(word) const must return const WordItem *");
+    static_assert(is_same<decltype(declval<Backend &>().insert(declval<string_view>(), declval<const WordItem &>())), void>::value,
+                  "Backend::insert(word, item) is missing");
+    static_assert(is_same<decltype(declval<Backend &>().insert(declval<string_view>(), declval<WordItem &&>())), void>::value,
+                  "Backend::insert(word, WordItem &&) is missing");
+    static_assert(is_same<decltype(declval<Backend &>().remove(declval<string_view>())), void>::value,
+                  "Backend::remove(word) is missing");
+    static_assert(is_same<decltype(declval<const Backend &>().memoryUsage()), MemoryReport>::value,
+                  "Backend::memoryUsage() must return MemoryReport");
+    static_assert(is_convertible<decltype(Backend::name()), string>::value,
+                  "Backend::name() must return the display name");
+    static const bool value = true;
+};
+
+// Whether a backend has finalize(), which SearchIndex calls once the posting
+// lists are attached to the word items
+template <class Backend, class = void>
+struct BackendFinalizes : false_type { };
+
+template <class Backend>
+struct BackendFinalizes<Backend, void_t<decltype(declval<Backend &>().finalize())>> : true_type { };
+
+// Whether a backend has bulkLoad(items), which SearchIndex uses to build an
+// empty dictionary from words added in sorted order in one pass
+template <class Backend, class = void>
+struct BackendBulkLoads : false_type { };
+
+template <class Backend>
+struct BackendBulkLoads<Backend, void_t<decltype(declval<Backend &>().bulkLoad(declval<vector<pair<string_view, WordItem>> &>()))>>
+    : true_type { };
+
+#endif /* Backend_h */
@@ -0,0 +1,155 @@
+#ifndef Bench_h
+#define Bench_h
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <utility>
+#include <random>
+#include <algorithm>
+#include <chrono>
+#include "BST.h"
+#include "STATS.h"
+
+using namespace std;
+
+// Benchmarks of the AVL tree on its own, away from the search pipeline.
+// Each one builds trees of random words and exits after printing.
+
+// Function to compare building a tree of count random words by repeated
+// insert (in random and in sorted order) with bulkLoad from the sorted words,
+// then time lookups and an in-order walk on the inserted and the bulk loaded tree.
+inline void benchmarkBulkLoad(ostream & out, size_t count) {
+
+    mt19937 random(13);
+    vector<pair<string, int>> sorted;
+    sorted.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        string word;
+        int length = 3 + random() % 10;
+        for (int j = 0; j < length; j++)
+            word += char('a' + random() % 26);
+        sorted.emplace_back(word, int(i));
+    }
+    sort(sorted.begin(), sorted.end());
+    sorted.erase(unique(sorted.begin(), sorted.end(), [](const pair<string, int> & a, const pair<string, int> & b) {
+        return a.first == b.first;
+    }), sorted.end());
+    vector<pair<string, int>> shuffled = sorted;
+    shuffle(shuffled.begin(), shuffled.end(), random);
+
+    AvlTree<string, int> inserted(""), ascending(""), loaded("");
+    auto start = chrono::high_resolution_clock::now();
+    for (const pair<string, int> & element : shuffled)
+        inserted.insert(element.first, element.second);
+    double insertMs = elapsedNanos(start) / 1e6;
+
+    start = chrono::high_resolution_clock::now();
+    for (const pair<string, int> & element : sorted)
+        ascending.insert(element.first, element.second);
+    double ascendingMs = elapsedNanos(start) / 1e6;
+
+    start = chrono::high_resolution_clock::now();
+    loaded.bulkLoad(sorted.begin(), sorted.end());
+    double bulkMs = elapsedNanos(start) / 1e6;
+
+    out << sorted.size() << " words: insert in random order " << insertMs << " ms (height " << inserted.treeHeight()
+        << "), insert in sorted order " << ascendingMs << " ms (height " << ascending.treeHeight() << "), bulkLoad "
+        << bulkMs << " ms (height " << loaded.treeHeight() << ", " << (loaded.verify() ? "valid" : "INVALID") << ")" << endl;
+
+    // Lookups in random order and one in-order walk over each tree
+    long long found = 0;
+    auto time = [&](const AvlTree<string, int> & tree, const string & name) {
+        auto start = chrono::high_resolution_clock::now();
+        for (const pair<string, int> & element : shuffled)
+            found += tree.findValue(element.first) != nullptr;
+        double lookupNanos = (double) elapsedNanos(start) / max<size_t>(shuffled.size(), 1);
+        start = chrono::high_resolution_clock::now();
+        tree.forEach([&](const string &, int details) { found += details; });
+        out << name << ": " << lookupNanos << " ns per lookup, in-order walk " << elapsedNanos(start) / 1e6 << " ms" << endl;
+    };
+    time(inserted, "Inserted in random order");
+    time(loaded, "Bulk loaded");
+    out << "(checksum " << found << ")" << endl;
+}
+
+// Function to time rank, select, countRange and rangeSum on a tree of count
+// random words weighing 1 to 1000 each, against in-order walks of the whole
+// tree answering the same questions. A tenth of the words are removed
+// first, so the sizes and totals have been through inserts, removes and
+// every kind of rotation; verify() then checks them.
+inline void benchmarkOrderStatistics(ostream & out, size_t count) {
+
+    mt19937 random(29);
+    vector<string> words;
+    AvlTree<string, int> tree("");
+    for (size_t i = 0; i < count; i++) {
+        string word;
+        int length = 3 + random() % 10;
+        for (int j = 0; j < length; j++)
+            word += char('a' + random() % 26);
+        tree.insert(word, int(1 + random() % 1000));
+        words.push_back(word);
+    }
+    for (size_t i = 0; i < count / 10; i++)
+        tree.remove(words[random() % words.size()]);
+    out << tree.size() << " words, height " << tree.treeHeight() << ", " << (tree.verify() ? "valid" : "INVALID") << endl;
+    if (tree.size() == 0)
+        return;
+
+    // Random bounds, some of them removed words, which are not in the tree
+    const int queries = 10000, scans = 20;
+    vector<pair<string, string>> ranges;
+    for (int i = 0; i < queries; i++) {
+        string low = words[random() % words.size()], high = words[random() % words.size()];
+        ranges.emplace_back(min(low, high), max(low, high));
+    }
+    vector<int> ranks;
+    for (int i = 0; i < queries; i++)
+        ranks.push_back(int(random() % tree.size()));
+
+    long long checksum = 0;
+    bool agree = true;
+    auto report = [&](const string & name, auto fast, auto scan) {
+        auto start = chrono::high_resolution_clock::now();
+        for (int i = 0; i < queries; i++)
+            checksum += fast(i);
+        double fastNanos = (double) elapsedNanos(start) / queries;
+        start = chrono::high_resolution_clock::now();
+        for (int i = 0; i < scans; i++)
+            agree = agree && scan(i) == fast(i);
+        double scanNanos = (double) elapsedNanos(start) / scans;
+        out << name << ": " << fastNanos << " ns, in-order walk " << scanNanos / 1000 << " us (" << scanNanos / fastNanos
+            << "x)" << endl;
+    };
+
+    report("rank", [&](int i) { return (long long) tree.rank(ranges[i].first); }, [&](int i) {
+        long long below = 0;
+        tree.forEach([&](const string & word, int) { below += word < ranges[i].first; });
+        return below;
+    });
+    report("select", [&](int i) { return (long long) tree.select(ranks[i]).size(); }, [&](int i) {
+        long long position = 0, length = 0;
+        tree.forEach([&](const string & word, int) {
+            if (position++ == ranks[i])
+                length = word.size();
+        });
+        return length;
+    });
+    report("countRange", [&](int i) { return (long long) tree.countRange(ranges[i].first, ranges[i].second); }, [&](int i) {
+        long long inside = 0;
+        tree.forEach([&](const string & word, int) { inside += !(word < ranges[i].first) && !(ranges[i].second < word); });
+        return inside;
+    });
+    report("rangeSum", [&](int i) { return tree.rangeSum(ranges[i].first, ranges[i].second); }, [&](int i) {
+        long long sum = 0;
+        tree.forEach([&](const string & word, int weight) {
+            if (!(word < ranges[i].first) && !(ranges[i].second < word))
+                sum += weight;
+        });
+        return sum;
+    });
+    out << "Answers " << (agree ? "agree" : "DISAGREE") << " with the walks (checksum " << checksum << ")" << endl;
+}
+
+#endif /* Bench_h */
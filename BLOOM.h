@@ -0,0 +1,132 @@
+#ifndef Bloom_h
+#define Bloom_h
+
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include "MEMORY.h"
+
+using namespace std;
+
+// Blocked Bloom filter: the bits of every key fall into one 64-byte block
+// (one cache line), chosen by the key's hash, so a lookup touches a single
+// line no matter how many bits are probed. A negative answer is exact; a
+// positive one is wrong with about the configured false positive rate while
+// no more than capacity() keys are added. Keys cannot be removed, so the
+// owner rebuilds the filter when it fills up or when words were removed.
+class BloomFilter
+{
+  public:
+
+    BloomFilter( ) : keyCapacity( 0 ), probes( 0 ), keys( 0 ) { }
+
+    void reset( size_t capacity, double falsePositiveRate ); // empty filter for capacity keys
+    void add( string_view key );
+    bool mayContain( string_view key ) const;
+    size_t size( ) const { return keys; }
+    size_t capacity( ) const { return keyCapacity; }
+    bool full( ) const { return keys >= keyCapacity; }
+    double bitsPerKey( ) const { return keyCapacity == 0 ? 0 : 512.0 * blocks.size( ) / keyCapacity; }
+    MemoryReport memoryUsage( ) const;
+
+  private:
+
+    struct alignas( 64 ) Block {
+
+        uint64_t words[ 8 ];
+    };
+
+    vector<Block> blocks;
+    size_t keyCapacity;
+    int probes; // Bits set per key, at most 7
+    size_t keys;
+
+    static uint64_t mix( uint64_t x );
+    static uint64_t hash( string_view key );
+};
+
+// 64-bit finalizer from MurmurHash3
+inline uint64_t BloomFilter::mix( uint64_t x )
+{
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+// Eight bytes at a time, each word folded in with a multiply; the tail is
+// read the same way, zero padded. The length is folded in last.
+inline uint64_t BloomFilter::hash( string_view key )
+{
+    uint64_t h = 0x9e3779b97f4a7c15ULL;
+    size_t i = 0;
+    for ( ; i + 8 <= key.size( ); i += 8 )
+    {
+        uint64_t word;
+        memcpy( &word, key.data( ) + i, 8 );
+        h = ( h ^ word ) * 0xff51afd7ed558ccdULL;
+        h ^= h >> 29;
+    }
+    uint64_t tail = 0;
+    if ( i < key.size( ) )
+        memcpy( &tail, key.data( ) + i, key.size( ) - i );
+    return mix( h ^ tail ^ ( uint64_t( key.size( ) ) << 56 ) );
+}
+
+/**
+ * Size the filter for capacity keys. The textbook -ln(p) / ln(2)^2 bits
+ * per key get a 20% allowance, because keys do not spread evenly
+ * over the blocks.
+ */
+inline void BloomFilter::reset( size_t capacity, double falsePositiveRate )
+{
+    falsePositiveRate = min( 0.5, max( 1e-6, falsePositiveRate ) );
+    double bits = 1.2 * -log( falsePositiveRate ) / ( log( 2.0 ) * log( 2.0 ) );
+    probes = max( 1, min( 7, int( lround( bits / 1.2 * log( 2.0 ) ) ) ) );
+    keyCapacity = max<size_t>( capacity, 64 );
+    blocks.assign( size_t( ceil( keyCapacity * bits / 512.0 ) ), Block( ) );
+    keys = 0;
+}
+
+/**
+ * The high half of the hash picks the block; each probe takes 9 bits of a
+ * second mix as a bit position inside the block.
+ */
+inline void BloomFilter::add( string_view key )
+{
+    uint64_t h = hash( key );
+    Block & block = blocks[ ( ( h >> 32 ) * blocks.size( ) ) >> 32 ];
+    uint64_t positions = mix( h + 0x9e3779b97f4a7c15ULL );
+    for ( int i = 0; i < probes; i++, positions >>= 9 )
+        block.words[ ( positions >> 6 ) & 7 ] |= 1ULL << ( positions & 63 );
+    keys++;
+}
+
+// The probed bits are and-ed together instead of returning at the first
+// clear one, which would be a mispredicted branch for most absent keys
+inline bool BloomFilter::mayContain( string_view key ) const
+{
+    if ( blocks.empty( ) )
+        return false;
+    uint64_t h = hash( key );
+    const Block & block = blocks[ ( ( h >> 32 ) * blocks.size( ) ) >> 32 ];
+    uint64_t positions = mix( h + 0x9e3779b97f4a7c15ULL );
+    uint64_t present = 1;
+    for ( int i = 0; i < probes; i++, positions >>= 9 )
+        present &= block.words[ ( positions >> 6 ) & 7 ] >> ( positions & 63 );
+    return present & 1;
+}
+
+inline MemoryReport BloomFilter::memoryUsage( ) const
+{
+    MemoryReport report;
+    accountVector( blocks, report.nodeBytes, report );
+    return report;
+}
+
+#endif /* Bloom_h */
@@ -5,10 +5,30 @@
 #include <cstddef>
 #include <vector>
 #include <iostream>
+#include <utility>
+#include <type_traits>
+#include "STATS.h"
+#include "MEMORY.h"
 
 using namespace std;
 
-template <class key, class value>
+// Weight of a value in the subtree totals kept by AvlTree, and the default
+// for its Weight parameter: numbers weigh their own value and other types
+// nothing. A tree whose values should weigh something else takes its own
+// functor, any class with long long operator()(const value &) const, as the
+// third template argument (the BST backend weighs a word by its occurrences).
+template <class value>
+struct AvlWeight {
+
+    long long operator()(const value & x) const {
+        if constexpr (is_arithmetic<value>::value)
+            return (long long) x;
+        else
+            return 0;
+    }
+};
+
+template <class key, class value, class Weight = AvlWeight<value>>
 class AvlTree;
 
 template <class key, class value>
@@ -20,15 +40,28 @@ public:
     AvlNode *left;
     AvlNode *right;
     int height;
+    int size; // Nodes in the subtree rooted here
+    long long weight; // Weight of details when it was last measured, set by the tree
+    long long total; // Sum of the weights in the subtree rooted here
 
     // Constructor
     AvlNode(const key & theWord, const value & theDetail, AvlNode *lt = nullptr, AvlNode *rt = nullptr, int h = 0 )
-            : word( theWord ), details(theDetail), left( lt ), right( rt ), height( h ) { }
-
-    friend class AvlTree<key, value>;
+            : word( theWord ), details(theDetail), left( lt ), right( rt ), height( h ), size( 1 ),
+              weight( 0 ), total( 0 ) { }
+    AvlNode(key && theWord, value && theDetail, AvlNode *lt = nullptr, AvlNode *rt = nullptr, int h = 0 )
+            : word( std::move(theWord) ), details( std::move(theDetail) ), left( lt ), right( rt ), height( h ), size( 1 ),
+              weight( 0 ), total( 0 ) { }
+
+    // Build the details in place from the arguments of AvlTree::emplace
+    template <class K, class... Args>
+    AvlNode(piecewise_construct_t, K && theWord, Args && ... args)
+            : word( std::forward<K>(theWord) ), details( std::forward<Args>(args)... ), left( nullptr ), right( nullptr ), height( 0 ),
+              size( 1 ), weight( 0 ), total( 0 ) { }
+
+    template <class, class, class> friend class AvlTree;
 };
 
-template <class key, class value>
+template <class key, class value, class Weight>
 class AvlTree {
     
 public:
@@ -41,12 +74,33 @@ public:
     const key & findMax( ) const;
     const key & find(const key & x) const;
     AvlNode<key, value> * update(const key & x);
+    const value * findValue(const key & x) const; // Read-only access to the details of x
+    value * findValue(const key & x); // Access to the details of x for in-place updates
     bool isEmpty( ) const;
     void printTree( ) const;
+    template <class Function>
+    void forEach(Function f) const; // Call f(key, value) for every node in sorted order
     int getBalance(AvlNode<key, value> * node);
+    int treeHeight( ) const; // Height of the root, -1 when empty
+    bool verify( ) const; // Whether every height, size and total field, balance factor and key order holds
+    int size( ) const; // Number of keys
+    int rank( const key & x ) const; // Number of keys smaller than x
+    const key & select( int i ) const; // Key of rank i (the i-th smallest from 0), ITEM_NOT_FOUND if out of range
+    int countRange( const key & low, const key & high ) const; // Number of keys in [low, high]
+    long long rangeSum( const key & low, const key & high ) const; // Total weight of the keys in [low, high]
+    void reweigh( const key & x ); // Measure the weight of x again after its details changed in place
+    void reweighAll( ); // Measure every weight again
     void makeEmpty( );
     void insert(const key & x, const value & y);
+    void insert(key && x, value && y); // Moves x and y into the new node
+    template <class K, class... Args>
+    void emplace(K && x, Args && ... args); // Constructs the value of a new node from args
+    template <class Iterator>
+    void bulkLoad(Iterator first, Iterator last); // Replace the contents with sorted, distinct (key, value) pairs
     void remove(const key & x);
+    AvlTreeStats stats( ) const; // Snapshot of the hot-path counters
+    void resetStats( );
+    MemoryReport memoryUsage( ) const; // Bytes held by nodes, keys and values
 
     const AvlTree & operator=(const AvlTree & rhs);
 
@@ -54,18 +108,33 @@ private:
     
     AvlNode<key, value> *root;
     const key ITEM_NOT_FOUND;
+    SEARCH_STAT(mutable AvlTreeStats statistics;)
+    SEARCH_STAT(mutable long long rotations = 0;) // Single rotations since construction
 
     const key & elementAt(AvlNode<key, value> *t ) const;
-    void insert(const key & x, const value & y, AvlNode<key, value> * & t) const;
+    template <class K, class... Args>
+    void insert(AvlNode<key, value> * & t, K && x, Args && ... args) const;
+    template <class Iterator>
+    AvlNode<key, value> * buildBalanced(Iterator first, size_t low, size_t high) const;
     void remove(const key & x, AvlNode<key, value> * & t);
     void printTree( AvlNode<key, value> *t ) const;
+    template <class Function>
+    void forEach(AvlNode<key, value> *t, Function & f) const;
     AvlNode<key, value> * findMin(AvlNode<key, value> *t) const;
     AvlNode<key, value> * findMax(AvlNode<key, value> *t) const;
     AvlNode<key, value> * find(const key & x, AvlNode<key, value> *t ) const;
     void makeEmpty(AvlNode<key, value> * & t) const;
+    void memoryUsage(AvlNode<key, value> *t, MemoryReport & report) const;
+    int verify(AvlNode<key, value> *t, const key * low, const key * high) const;
+    void prefix(const key & x, bool inclusive, int & count, long long & sum) const;
+    bool reweigh(const key & x, AvlNode<key, value> *t);
+    void reweighAll(AvlNode<key, value> *t);
 
     // AVL tree balancing functions
     int height(AvlNode<key, value> *t) const;
+    int size(AvlNode<key, value> *t) const;
+    long long total(AvlNode<key, value> *t) const;
+    void refresh(AvlNode<key, value> *t) const;
     int max(int lhs, int rhs) const;
     void rotateWithLeftChild(AvlNode<key, value> * & k2) const;
     void rotateWithRightChild(AvlNode<key, value> * & k1) const;
@@ -74,22 +143,43 @@ private:
 };
 
 // Constructor
-template <class key, class value>
-AvlTree<key, value>::AvlTree(const key & notFound)
+template <class key, class value, class Weight>
+AvlTree<key, value, Weight>::AvlTree(const key & notFound)
 : ITEM_NOT_FOUND( notFound ), root( nullptr ) {}
 
 // Get the height of a node
-template <class key, class value>
-int AvlTree<key, value>::height(AvlNode<key, value> *t) const {
+template <class key, class value, class Weight>
+int AvlTree<key, value, Weight>::height(AvlNode<key, value> *t) const {
     
     if (t == nullptr)
         return -1;
     return t->height;
 }
 
+// Get the number of nodes in a subtree
+template <class key, class value, class Weight>
+int AvlTree<key, value, Weight>::size(AvlNode<key, value> *t) const {
+    return t == nullptr ? 0 : t->size;
+}
+
+// Get the total weight of a subtree
+template <class key, class value, class Weight>
+long long AvlTree<key, value, Weight>::total(AvlNode<key, value> *t) const {
+    return t == nullptr ? 0 : t->total;
+}
+
+// Recompute the height, size and total of a node from its children.
+// Every place that changes a node's children calls it, bottom up.
+template <class key, class value, class Weight>
+void AvlTree<key, value, Weight>::refresh(AvlNode<key, value> *t) const {
+    t->height = max(height(t->left), height(t->right)) + 1;
+    t->size = size(t->left) + size(t->right) + 1;
+    t->total = total(t->left) + total(t->right) + t->weight;
+}
+
 // Get the maximum of two integers
-template <class key, class value>
-int AvlTree<key, value>::max(int lhs, int rhs) const {
+template <class key, class value, class Weight>
+int AvlTree<key, value, Weight>::max(int lhs, int rhs) const {
     
     if (lhs > rhs)
         return lhs;
@@ -97,22 +187,44 @@ int AvlTree<key, value>::max(int lhs, int rhs) const {
 }
 
 // Insert a node into the AVL tree
-template <class key, class value>
-void AvlTree<key, value>::insert(const key & x, const value & y){
-    insert( x, y, root);
+template <class key, class value, class Weight>
+void AvlTree<key, value, Weight>::insert(const key & x, const value & y){
+    emplace(x, y);
 }
 
-// Internal method to insert into a subtree
-template <class key, class value>
-void AvlTree<key, value>::insert(const key & x, const value & y, AvlNode<key, value> * & t) const{
+// Insert a node into the AVL tree, moving the key and value into it
+template <class key, class value, class Weight>
+void AvlTree<key, value, Weight>::insert(key && x, value && y){
+    emplace(std::move(x), std::move(y));
+}
+
+// Insert a node whose value is constructed from args; nothing happens if x is present
+template <class key, class value, class Weight>
+template <class K, class... Args>
+void AvlTree<key, value, Weight>::emplace(K && x, Args && ... args){
+    SEARCH_STAT(long long before = rotations;)
+    insert(root, std::forward<K>(x), std::forward<Args>(args)...);
+    SEARCH_STAT(statistics.inserts++;)
+    SEARCH_STAT(statistics.insertRotations += rotations - before;)
+    SEARCH_STAT(statistics.rotationsPerInsert.record(int(rotations - before));)
+}
+
+// Internal method to insert into a subtree.
+// x may be moved into the new node, so the rotation cases are told apart by heights.
+template <class key, class value, class Weight>
+template <class K, class... Args>
+void AvlTree<key, value, Weight>::insert(AvlNode<key, value> * & t, K && x, Args && ... args) const{
     
     if (t == nullptr)
-        t = new AvlNode<key, value>(x, y, nullptr, nullptr, 0);
+    {
+        t = new AvlNode<key, value>(piecewise_construct, std::forward<K>(x), std::forward<Args>(args)...);
+        t->weight = t->total = Weight()(t->details);
+    }
     
     else if (x < t->word) {
-        insert(x, y, t->left);
+        insert(t->left, std::forward<K>(x), std::forward<Args>(args)...);
         if ( height(t->left) - height( t->right ) == 2 ){
-            if (x < t->left->word)  // X was inserted to the left-left subtree!
+            if (height(t->left->left) > height(t->left->right))  // X was inserted to the left-left subtree!
                 rotateWithLeftChild(t);
             else                 // X was inserted to the left-right subtree!
                 doubleWithLeftChild(t);
@@ -120,9 +232,9 @@ void AvlTree<key, value>::insert(const key & x, const value & y, AvlNode<key, va
         
     } else if(t->word < x) {    // Otherwise X is inserted to the right subtree
         
-        insert(x, y, t->right);
+        insert(t->right, std::forward<K>(x), std::forward<Args>(args)...);
         if (height(t->right) - height(t->left) == 2){ // height of the right subtree increased
-            if (t->right->word < x) // X was inserted to right-right subtree
+            if (height(t->right->right) > height(t->right->left)) // X was inserted to right-right subtree
                 rotateWithRightChild(t);
             else // X was inserted to right-left subtree
                 doubleWithRightChild(t);
@@ -130,37 +242,72 @@ void AvlTree<key, value>::insert(const key & x, const value & y, AvlNode<key, va
     }
     else
         ;
-    t->height = max(height(t->left), height(t->right)) + 1;
+    refresh(t);
+}
+
+// Build a perfectly balanced tree from a range of (key, value) pairs sorted by
+// key with no duplicates, in O(n) and without a single comparison or rotation.
+// The range must be random access; pass move iterators to move the pairs in.
+template <class key, class value, class Weight>
+template <class Iterator>
+void AvlTree<key, value, Weight>::bulkLoad(Iterator first, Iterator last){
+    makeEmpty(root);
+    root = buildBalanced(first, 0, size_t(last - first));
+}
+
+// Internal method to build the subtree of elements [low, high) around the middle one.
+// The left subtree is allocated before its parent and the right one after, so the
+// nodes come out of the allocator in in-order order and an in-order walk, like a
+// range of neighbouring keys, mostly moves forward through memory. Both halves
+// differ in size by at most one, so their heights differ by at most one too.
+template <class key, class value, class Weight>
+template <class Iterator>
+AvlNode<key, value> * AvlTree<key, value, Weight>::buildBalanced(Iterator first, size_t low, size_t high) const{
+    
+    if (low >= high)
+        return nullptr;
+    size_t middle = low + (high - low) / 2;
+    AvlNode<key, value> * left = buildBalanced(first, low, middle);
+    auto && element = first[middle];
+    AvlNode<key, value> * t = new AvlNode<key, value>(piecewise_construct, std::forward<decltype(element)>(element).first,
+                                                      std::forward<decltype(element)>(element).second);
+    t->weight = Weight()(t->details);
+    t->left = left;
+    t->right = buildBalanced(first, middle + 1, high);
+    refresh(t);
+    return t;
 }
 
 // Rotate binary tree node with left child
-template <class key, class value>
-void AvlTree<key, value>::rotateWithLeftChild(AvlNode<key, value> * & k2) const{ // rotate_right
+template <class key, class value, class Weight>
+void AvlTree<key, value, Weight>::rotateWithLeftChild(AvlNode<key, value> * & k2) const{ // rotate_right
     
+    SEARCH_STAT(rotations++;)
     AvlNode<key, value> *k1 = k2->left;
     k2->left = k1->right;
     k1->right = k2;
-    k2->height = max(height(k2->left), height(k2->right)) + 1;
-    k1->height = max( height( k1->left ), k2->height ) + 1;
+    refresh(k2);
+    refresh(k1);
     k2 = k1;
 }
 
 // Rotate binary tree node with right child
-template <class key, class value>
-void AvlTree<key, value>::rotateWithRightChild(AvlNode<key, value> * & k1) const{ // rotate_left
+template <class key, class value, class Weight>
+void AvlTree<key, value, Weight>::rotateWithRightChild(AvlNode<key, value> * & k1) const{ // rotate_left
     
+    SEARCH_STAT(rotations++;)
     AvlNode<key, value> *k2 = k1->right;
     k1->right = k2->left;
     k2->left = k1;
-    k1->height = max(height(k1->left), height(k1->right)) + 1;
-    k2->height = max(height(k2->right), k1->height) + 1;
+    refresh(k1);
+    refresh(k2);
     k1 = k2;
 }
 
 // Double rotate binary tree node: first left child
 // with its right child; then node k3 with new left child
-template <class key, class value>
-void AvlTree<key, value>::doubleWithLeftChild(AvlNode<key, value> * & k3) const{
+template <class key, class value, class Weight>
+void AvlTree<key, value, Weight>::doubleWithLeftChild(AvlNode<key, value> * & k3) const{
     
     rotateWithRightChild(k3->left);
     rotateWithLeftChild(k3);
@@ -168,34 +315,74 @@ void AvlTree<key, value>::doubleWithLeftChild(AvlNode<key, value> * & k3) const{
 
 // Double rotate binary tree node: first right child
 // with its left child; then node k1 with new right child
-template <class key, class value>
-void AvlTree<key, value>::doubleWithRightChild(AvlNode<key, value> * & k1) const{
+template <class key, class value, class Weight>
+void AvlTree<key, value, Weight>::doubleWithRightChild(AvlNode<key, value> * & k1) const{
     
     rotateWithLeftChild(k1->right);
     rotateWithRightChild(k1);
 }
 
 // Find the element at the given node
-template <class key, class value>
-const key & AvlTree<key, value>::elementAt(AvlNode<key, value> *t) const{
+template <class key, class value, class Weight>
+const key & AvlTree<key, value, Weight>::elementAt(AvlNode<key, value> *t) const{
     return t == nullptr ? ITEM_NOT_FOUND : t->word;
 }
 
 // Update the details of a node with the given key
-template <class key, class value>
-AvlNode<key, value> *  AvlTree<key, value>::update(const key & x){
-    return find(x, root);
+template <class key, class value, class Weight>
+AvlNode<key, value> *  AvlTree<key, value, Weight>::update(const key & x){
+    SEARCH_STAT(long long before = statistics.comparisons;)
+    AvlNode<key, value> * match = find(x, root);
+    SEARCH_STAT(statistics.finds++;)
+    SEARCH_STAT(statistics.comparisonsPerFind.record(int(statistics.comparisons - before));)
+    return match;
+}
+
+// Visit every node in sorted (in-order) order
+template <class key, class value, class Weight>
+template <class Function>
+void AvlTree<key, value, Weight>::forEach(Function f) const {
+    forEach(root, f);
+}
+
+// Internal method to visit a subtree rooted at t in order
+template <class key, class value, class Weight>
+template <class Function>
+void AvlTree<key, value, Weight>::forEach(AvlNode<key, value> *t, Function & f) const {
+    
+    if (t != nullptr){
+        forEach(t->left, f);
+        f(t->word, t->details);
+        forEach(t->right, f);
+    }
+}
+
+// Find the details of a given key, nullptr if the key is not in the tree
+template <class key, class value, class Weight>
+const value * AvlTree<key, value, Weight>::findValue(const key & x) const {
+    SEARCH_STAT(long long before = statistics.comparisons;)
+    AvlNode<key, value> * match = find(x, root);
+    SEARCH_STAT(statistics.finds++;)
+    SEARCH_STAT(statistics.comparisonsPerFind.record(int(statistics.comparisons - before));)
+    return match == nullptr ? nullptr : &match->details;
+}
+
+// Find the details of a given key for in-place updates, nullptr if absent
+template <class key, class value, class Weight>
+value * AvlTree<key, value, Weight>::findValue(const key & x) {
+    AvlNode<key, value> * match = update(x);
+    return match == nullptr ? nullptr : &match->details;
 }
 
 // Print the AVL tree
-template <class key, class value>
-void AvlTree<key, value>::printTree() const {
+template <class key, class value, class Weight>
+void AvlTree<key, value, Weight>::printTree() const {
     printTree(root);
 }
 
 // Internal method to print a subtree rooted at t
-template <class key, class value>
-void AvlTree<key, value>::printTree( AvlNode<key, value> * t ) const {
+template <class key, class value, class Weight>
+void AvlTree<key, value, Weight>::printTree( AvlNode<key, value> * t ) const {
     
     if (t != nullptr){
         printTree( t->left );
@@ -205,18 +392,23 @@ void AvlTree<key, value>::printTree( AvlNode<key, value> * t ) const {
 }
 
 // Find a given key in the AVL tree
-template <class key, class value>
-const key & AvlTree<key, value>::find( const key & x ) const {
-    return elementAt( find( x, root ) );
+template <class key, class value, class Weight>
+const key & AvlTree<key, value, Weight>::find( const key & x ) const {
+    SEARCH_STAT(long long before = statistics.comparisons;)
+    AvlNode<key, value> * match = find( x, root );
+    SEARCH_STAT(statistics.finds++;)
+    SEARCH_STAT(statistics.comparisonsPerFind.record(int(statistics.comparisons - before));)
+    return elementAt( match );
 }
 
 // Internal method to find an element in a subtree
-template <class key, class value>
-AvlNode<key, value> * AvlTree<key, value>::find( const key & x, AvlNode<key, value> *t ) const {
+template <class key, class value, class Weight>
+AvlNode<key, value> * AvlTree<key, value, Weight>::find( const key & x, AvlNode<key, value> *t ) const {
     
     if (t == nullptr)
         return nullptr;
-    else if(x < t->word)
+    SEARCH_STAT(statistics.comparisons++;)
+    if(x < t->word)
         return find(x, t->left);
     else if(t->word < x)
         return find(x, t->right);
@@ -225,14 +417,14 @@ AvlNode<key, value> * AvlTree<key, value>::find( const key & x, AvlNode<key, val
 }
 
 // Find the minimum element in the AVL tree
-template <class key, class value>
-const key & AvlTree<key, value>::findMin( ) const {
+template <class key, class value, class Weight>
+const key & AvlTree<key, value, Weight>::findMin( ) const {
     return elementAt( findMin( root ) );
 }
 
 // Find the minimum element in a subtree
-template <class key, class value>
-AvlNode<key, value> * AvlTree<key, value>::findMin( AvlNode<key, value> *t ) const {
+template <class key, class value, class Weight>
+AvlNode<key, value> * AvlTree<key, value, Weight>::findMin( AvlNode<key, value> *t ) const {
     
     if( t == nullptr )
         return nullptr;
@@ -242,14 +434,14 @@ AvlNode<key, value> * AvlTree<key, value>::findMin( AvlNode<key, value> *t ) con
 }
 
 // Find the maximum element in the AVL tree
-template <class key, class value>
-const key & AvlTree<key, value>::findMax( ) const {
+template <class key, class value, class Weight>
+const key & AvlTree<key, value, Weight>::findMax( ) const {
     return elementAt( findMax( root ) );
 }
 
 // Find the maximum element in a subtree
-template <class key, class value>
-AvlNode<key, value> * AvlTree<key, value>::findMax( AvlNode<key, value> *t ) const {
+template <class key, class value, class Weight>
+AvlNode<key, value> * AvlTree<key, value, Weight>::findMax( AvlNode<key, value> *t ) const {
     
     if(t != nullptr){
         while(t->right != nullptr){
@@ -260,20 +452,20 @@ AvlNode<key, value> * AvlTree<key, value>::findMax( AvlNode<key, value> *t ) con
 }
 
 // Check if the AVL tree is empty
-template <class key, class value>
-bool AvlTree<key, value>::isEmpty( ) const {
+template <class key, class value, class Weight>
+bool AvlTree<key, value, Weight>::isEmpty( ) const {
     return root == nullptr;
 }
 
 // Make the AVL tree empty
-template <class key, class value>
-void AvlTree<key, value>::makeEmpty( ) {
+template <class key, class value, class Weight>
+void AvlTree<key, value, Weight>::makeEmpty( ) {
     makeEmpty(root);
 }
 
 // Internal method to make a subtree empty
-template <class key, class value>
-void AvlTree<key, value>::makeEmpty(AvlNode<key, value> * & t ) const {
+template <class key, class value, class Weight>
+void AvlTree<key, value, Weight>::makeEmpty(AvlNode<key, value> * & t ) const {
     
     if(t != nullptr){
         makeEmpty( t->left );
@@ -284,29 +476,227 @@ void AvlTree<key, value>::makeEmpty(AvlNode<key, value> * & t ) const {
 }
 
 // Destructor
-template <class key, class value>
-AvlTree<key, value>::~AvlTree() {
+template <class key, class value, class Weight>
+AvlTree<key, value, Weight>::~AvlTree() {
     makeEmpty(root);
 }
 
 // Remove a node from the AVL tree
-template <class key, class value>
-void AvlTree<key, value>::remove(const key & x){
+template <class key, class value, class Weight>
+void AvlTree<key, value, Weight>::remove(const key & x){
+    SEARCH_STAT(long long before = rotations;)
     remove(x, root);
+    SEARCH_STAT(statistics.removes++;)
+    SEARCH_STAT(statistics.removeRotations += rotations - before;)
+    SEARCH_STAT(statistics.rotationsPerRemove.record(int(rotations - before));)
+}
+
+// Snapshot of the hot-path counters (all zero unless built with SEARCH_STATS)
+template <class key, class value, class Weight>
+AvlTreeStats AvlTree<key, value, Weight>::stats( ) const {
+    AvlTreeStats snapshot;
+    SEARCH_STAT(snapshot = statistics;)
+    return snapshot;
+}
+
+// Walk the tree and break its memory down by component
+template <class key, class value, class Weight>
+MemoryReport AvlTree<key, value, Weight>::memoryUsage( ) const {
+    MemoryReport report;
+    memoryUsage(root, report);
+    return report;
+}
+
+// Internal method to account a subtree rooted at t
+template <class key, class value, class Weight>
+void AvlTree<key, value, Weight>::memoryUsage(AvlNode<key, value> *t, MemoryReport & report) const {
+    
+    if (t != nullptr){
+        report.nodeBytes += sizeof(AvlNode<key, value>);
+        addAllocation(report, sizeof(AvlNode<key, value>));
+        report.keyBytes += heapBytes(t->word);
+        addAllocation(report, heapBytes(t->word));
+        accountMemory(t->details, report);
+        memoryUsage(t->left, report);
+        memoryUsage(t->right, report);
+    }
+}
+
+// Reset the hot-path counters
+template <class key, class value, class Weight>
+void AvlTree<key, value, Weight>::resetStats( ) {
+    SEARCH_STAT(statistics = AvlTreeStats();)
 }
 
 // Get the balance factor of a node
-template <class key, class value>
-int AvlTree<key, value>::getBalance(AvlNode<key, value> * node){
+template <class key, class value, class Weight>
+int AvlTree<key, value, Weight>::getBalance(AvlNode<key, value> * node){
     
     if (node == nullptr)
         return 0;
     return height(node->left) - height(node->right);
 }
 
+// Height of the root, -1 when empty
+template <class key, class value, class Weight>
+int AvlTree<key, value, Weight>::treeHeight( ) const {
+    return height(root);
+}
+
+// Check the whole tree: stored heights, balance factors and key order
+template <class key, class value, class Weight>
+bool AvlTree<key, value, Weight>::verify( ) const {
+    return verify(root, nullptr, nullptr) >= -1;
+}
+
+// Internal method to check a subtree whose keys lie strictly between low and high
+// (nullptr for no bound); returns its height, or -2 if anything is off. Sizes and
+// totals are checked against the children, and weights against the details.
+template <class key, class value, class Weight>
+int AvlTree<key, value, Weight>::verify(AvlNode<key, value> *t, const key * low, const key * high) const {
+    
+    if (t == nullptr)
+        return -1;
+    if ((low != nullptr && !(*low < t->word)) || (high != nullptr && !(t->word < *high)))
+        return -2;
+    int lh = verify(t->left, low, &t->word), rh = verify(t->right, &t->word, high);
+    if (lh < -1 || rh < -1 || lh - rh > 1 || rh - lh > 1 || t->height != max(lh, rh) + 1)
+        return -2;
+    if (t->size != size(t->left) + size(t->right) + 1 || t->weight != Weight()(t->details)
+        || t->total != total(t->left) + total(t->right) + t->weight)
+        return -2;
+    return t->height;
+}
+
+// Number of keys, from the subtree size of the root
+template <class key, class value, class Weight>
+int AvlTree<key, value, Weight>::size( ) const {
+    return size(root);
+}
+
+// Internal method to count and weigh the keys smaller than x (or not larger,
+// when inclusive) on one path from the root: every time the path turns
+// right, the node and its whole left subtree lie below x
+template <class key, class value, class Weight>
+void AvlTree<key, value, Weight>::prefix(const key & x, bool inclusive, int & count, long long & sum) const {
+    
+    count = 0;
+    sum = 0;
+    AvlNode<key, value> *t = root;
+    while (t != nullptr){
+        if (t->word < x || (inclusive && !(x < t->word))){
+            count += size(t->left) + 1;
+            sum += total(t->left) + t->weight;
+            t = t->right;
+        }
+        else
+            t = t->left;
+    }
+}
+
+// Number of keys smaller than x, in O(log n)
+template <class key, class value, class Weight>
+int AvlTree<key, value, Weight>::rank(const key & x) const {
+    int count;
+    long long sum;
+    prefix(x, false, count, sum);
+    return count;
+}
+
+// Key of rank i, in O(log n): go left while the left subtree holds more than i keys
+template <class key, class value, class Weight>
+const key & AvlTree<key, value, Weight>::select(int i) const {
+    
+    if (i < 0 || i >= size(root))
+        return ITEM_NOT_FOUND;
+    AvlNode<key, value> *t = root;
+    while (true){
+        int below = size(t->left);
+        if (i < below)
+            t = t->left;
+        else if (i > below){
+            i -= below + 1;
+            t = t->right;
+        }
+        else
+            return t->word;
+    }
+}
+
+// Number of keys in [low, high], in O(log n)
+template <class key, class value, class Weight>
+int AvlTree<key, value, Weight>::countRange(const key & low, const key & high) const {
+    
+    if (high < low)
+        return 0;
+    int below, upTo;
+    long long belowSum, upToSum;
+    prefix(low, false, below, belowSum);
+    prefix(high, true, upTo, upToSum);
+    return upTo - below;
+}
+
+// Total weight of the keys in [low, high], in O(log n)
+template <class key, class value, class Weight>
+long long AvlTree<key, value, Weight>::rangeSum(const key & low, const key & high) const {
+    
+    if (high < low)
+        return 0;
+    int below, upTo;
+    long long belowSum, upToSum;
+    prefix(low, false, below, belowSum);
+    prefix(high, true, upTo, upToSum);
+    return upToSum - belowSum;
+}
+
+// Measure the weight of x again, after its details were changed through
+// findValue or update, and fix the totals on the path to it
+template <class key, class value, class Weight>
+void AvlTree<key, value, Weight>::reweigh(const key & x) {
+    reweigh(x, root);
+}
+
+// Internal method to reweigh x in a subtree; returns whether x was found
+template <class key, class value, class Weight>
+bool AvlTree<key, value, Weight>::reweigh(const key & x, AvlNode<key, value> *t) {
+    
+    if (t == nullptr)
+        return false;
+    if (x < t->word){
+        if (!reweigh(x, t->left))
+            return false;
+    }
+    else if (t->word < x){
+        if (!reweigh(x, t->right))
+            return false;
+    }
+    else
+        t->weight = Weight()(t->details);
+    t->total = total(t->left) + total(t->right) + t->weight;
+    return true;
+}
+
+// Measure every weight again, in O(n), after many details changed in place
+template <class key, class value, class Weight>
+void AvlTree<key, value, Weight>::reweighAll( ) {
+    reweighAll(root);
+}
+
+// Internal method to reweigh a subtree, children first
+template <class key, class value, class Weight>
+void AvlTree<key, value, Weight>::reweighAll(AvlNode<key, value> *t) {
+    
+    if (t != nullptr){
+        reweighAll(t->left);
+        reweighAll(t->right);
+        t->weight = Weight()(t->details);
+        t->total = total(t->left) + total(t->right) + t->weight;
+    }
+}
+
 // Internal method to remove a node from a subtree
-template <class key, class value>
-void AvlTree<key, value>::remove(const key & x, AvlNode<key, value> * & t) {
+template <class key, class value, class Weight>
+void AvlTree<key, value, Weight>::remove(const key & x, AvlNode<key, value> * & t) {
     
     if (t == nullptr)
         return; // Element not found or tree is empty
@@ -318,7 +708,11 @@ void AvlTree<key, value>::remove(const key & x, AvlNode<key, value> * & t) {
         remove(x, t->right);
     
     else if (t->left != nullptr && t->right != nullptr) {
-        t->word = findMin(t->right)->word;
+        // Take over the successor's key and details, then remove the successor
+        AvlNode<key, value> * successor = findMin(t->right);
+        t->word = successor->word;
+        t->details = std::move(successor->details);
+        t->weight = successor->weight;
         remove(t->word, t->right);
         
     } 
@@ -332,7 +726,7 @@ void AvlTree<key, value>::remove(const key & x, AvlNode<key, value> * & t) {
     if (t == nullptr)
         return;
 
-    t->height = max(height(t->left), height(t->right)) + 1;
+    refresh(t);
 
     if (height(t->left) - height(t->right) == 2) {
         
@@ -0,0 +1,273 @@
+#ifndef Cache_h
+#define Cache_h
+
+#include <string>
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <unordered_set>
+#include <algorithm>
+#include "QUERY.h"
+#include "STATS.h"
+
+using namespace std;
+
+// Struct to count cache traffic
+struct CacheStats {
+
+    long long hits = 0;
+    long long misses = 0;
+    long long evictions = 0; // Entries dropped to stay within the budget
+    long long invalidations = 0; // Entries dropped because a word was mutated
+
+    double hitRate() const {
+        return hits + misses == 0 ? 0.0 : (double) hits / (hits + misses);
+    }
+};
+
+// LRU cache of query results with a size budget in bytes.
+// Results are keyed on the sorted, deduplicated word list, so "b a", "a b"
+// and "a b a" share one entry. Every cached query is also indexed by each
+// of its words, so mutating a word drops exactly the results that used it.
+class QueryCache
+{
+  public:
+
+    explicit QueryCache( size_t budget = 1 << 20 ) : budgetBytes( budget ), usedBytes( 0 ) { }
+
+    const QueryResult * lookup( const vector<string> & canonical );
+    void insert( const vector<string> & canonical, const QueryResult & result );
+    void invalidate( const string & word );
+    void clear( );
+
+    CacheStats stats( ) const { return counters; }
+    size_t size( ) const { return entries.size( ); }
+    size_t bytes( ) const { return usedBytes; }
+
+  private:
+
+    struct CacheEntry
+    {
+        string key;
+        QueryResult result;
+        size_t bytes;
+    };
+
+    list<CacheEntry> lru; // Most recently used first
+    unordered_map<string, list<CacheEntry>::iterator> entries;
+    unordered_map<string, unordered_set<string>> keysByWord;
+    size_t budgetBytes;
+    size_t usedBytes;
+    CacheStats counters;
+
+    static string makeKey( const vector<string> & canonical );
+    static size_t entryBytes( const CacheEntry & entry );
+    void erase( list<CacheEntry>::iterator it );
+};
+
+// Function to sort and deduplicate query words, the form results are cached under
+inline vector<string> canonicalWords(const vector<string> & words) {
+
+    vector<string> canonical = words;
+    sort(canonical.begin(), canonical.end());
+    canonical.erase(unique(canonical.begin(), canonical.end()), canonical.end());
+    return canonical;
+}
+
+// Function to rearrange a result computed for the canonical words into the order of the query
+inline QueryResult projectResult(const QueryResult & canonical, const vector<string> & words) {
+
+    QueryResult result;
+    result.words = words;
+    vector<int> column;
+    for (const string & word : words)
+        column.push_back(int(lower_bound(canonical.words.begin(), canonical.words.end(), word) - canonical.words.begin()));
+
+    for (const QueryMatch & match : canonical.matches) {
+        QueryMatch projected;
+        projected.document = match.document;
+        projected.documentName = match.documentName;
+        for (int c : column)
+            projected.counts.push_back(match.counts[c]);
+        result.matches.push_back(projected);
+    }
+    return result;
+}
+
+// Function to check that two results list the same documents with the same counts
+inline bool sameResult(const QueryResult & a, const QueryResult & b) {
+
+    if (a.matches.size() != b.matches.size())
+        return false;
+    for (size_t i = 0; i < a.matches.size(); i++)
+        if (a.matches[i].document != b.matches[i].document || a.matches[i].documentName != b.matches[i].documentName
+            || a.matches[i].counts != b.matches[i].counts)
+            return false;
+    return true;
+}
+
+// Function to evaluate a parsed query through the cache
+template <class Lookup>
+QueryResult cachedQuery(QueryCache & cache, const vector<string> & words, Lookup lookup) {
+
+    vector<string> canonical = canonicalWords(words);
+    const QueryResult * cached = cache.lookup(canonical);
+    if (cached != nullptr)
+        return projectResult(*cached, words);
+
+    QueryResult result = evaluateQuery(canonical, lookup);
+    cache.insert(canonical, result);
+    return projectResult(result, words);
+}
+
+inline string QueryCache::makeKey( const vector<string> & canonical )
+{
+    string key;
+    for ( const string & word : canonical )
+    {
+        key += word;
+        key += ' ';
+    }
+    return key;
+}
+
+inline size_t QueryCache::entryBytes( const CacheEntry & entry )
+{
+    size_t bytes = sizeof( CacheEntry ) + 2 * entry.key.size( );
+    for ( const string & word : entry.result.words )
+        bytes += sizeof( string ) + word.size( );
+    for ( const QueryMatch & match : entry.result.matches )
+        bytes += sizeof( QueryMatch ) + match.documentName.size( ) + match.counts.size( ) * sizeof( int );
+    return bytes;
+}
+
+/**
+ * Return the cached result for the canonical words, or nullptr on a miss.
+ * The pointer stays valid until the next insert, invalidate or clear.
+ */
+inline const QueryResult * QueryCache::lookup( const vector<string> & canonical )
+{
+    auto found = entries.find( makeKey( canonical ) );
+    if ( found == entries.end( ) )
+    {
+        counters.misses++;
+        return nullptr;
+    }
+    counters.hits++;
+    lru.splice( lru.begin( ), lru, found->second );    // mark as most recently used
+    return &found->second->result;
+}
+
+/**
+ * Insert a result, evicting least recently used entries
+ * until the cache fits its budget again.
+ */
+inline void QueryCache::insert( const vector<string> & canonical, const QueryResult & result )
+{
+    string key = makeKey( canonical );
+    auto found = entries.find( key );
+    if ( found != entries.end( ) )
+        erase( found->second );
+
+    lru.push_front( CacheEntry{ key, result, 0 } );
+    lru.front( ).result.words = canonical;    // erase() unlinks the entry through these words
+    lru.front( ).bytes = entryBytes( lru.front( ) );
+    if ( lru.front( ).bytes > budgetBytes )
+    {
+        lru.pop_front( );    // never cache what cannot fit
+        return;
+    }
+    entries[ key ] = lru.begin( );
+    usedBytes += lru.front( ).bytes;
+    for ( const string & word : canonical )
+        keysByWord[ word ].insert( key );
+
+    while ( usedBytes > budgetBytes )
+    {
+        erase( prev( lru.end( ) ) );
+        counters.evictions++;
+    }
+}
+
+/**
+ * Drop every cached result whose query contains word.
+ * Call this whenever the postings of word change.
+ */
+inline void QueryCache::invalidate( const string & word )
+{
+    auto found = keysByWord.find( word );
+    if ( found == keysByWord.end( ) )
+        return;
+
+    vector<string> keys( found->second.begin( ), found->second.end( ) );
+    for ( const string & key : keys )
+    {
+        erase( entries[ key ] );
+        counters.invalidations++;
+    }
+}
+
+inline void QueryCache::clear( )
+{
+    counters.invalidations += entries.size( );
+    lru.clear( );
+    entries.clear( );
+    keysByWord.clear( );
+    usedBytes = 0;
+}
+
+inline void QueryCache::erase( list<CacheEntry>::iterator it )
+{
+    for ( const string & word : it->result.words )
+    {
+        auto keys = keysByWord.find( word );
+        keys->second.erase( it->key );
+        if ( keys->second.empty( ) )
+            keysByWord.erase( keys );
+    }
+    usedBytes -= it->bytes;
+    entries.erase( it->key );
+    lru.erase( it );
+}
+
+// Function to replay a Zipfian sample of the log with and without a cache
+// and report hit rate and latency. Cached answers are checked against the
+// uncached ones so a stale entry shows up as a mismatch.
+template <class Lookup>
+void benchmarkCache(ostream & out, const string & name, const vector<string> & log,
+                    size_t count, size_t budget, Lookup lookup) {
+
+    vector<string> replay = zipfianReplay(log, count, 1.0);
+    vector<vector<string>> parsed;
+    for (const string & line : replay)
+        parsed.push_back(parseQuery(line));
+
+    vector<long long> uncachedNanos, cachedNanos;
+    vector<QueryResult> expected;
+    for (const vector<string> & words : parsed) {
+        auto start = chrono::high_resolution_clock::now();
+        expected.push_back(evaluateQuery(words, lookup));
+        uncachedNanos.push_back(elapsedNanos(start));
+    }
+
+    QueryCache cache(budget);
+    size_t mismatches = 0;
+    for (int i = 0; i < parsed.size(); i++) {
+        auto start = chrono::high_resolution_clock::now();
+        QueryResult result = cachedQuery(cache, parsed[i], lookup);
+        cachedNanos.push_back(elapsedNanos(start));
+        if (!sameResult(result, expected[i]))
+            mismatches++;
+    }
+
+    CacheStats stats = cache.stats();
+    out << name << " Zipfian replay of " << parsed.size() << " queries, cache budget " << budget << " bytes" << endl;
+    out << "  hit rate " << stats.hitRate() << " (" << stats.hits << " hits, " << stats.misses << " misses, "
+        << stats.evictions << " evictions, " << cache.size() << " entries), " << mismatches << " mismatches" << endl;
+    out << "  uncached: mean " << meanNanos(uncachedNanos) << " ns, p50 " << percentileNanos(uncachedNanos, 50)
+        << " ns, p99 " << percentileNanos(uncachedNanos, 99) << " ns" << endl;
+    out << "  cached:   mean " << meanNanos(cachedNanos) << " ns, p50 " << percentileNanos(cachedNanos, 50)
+        << " ns, p99 " << percentileNanos(cachedNanos, 99) << " ns" << endl;
+}
+
+#endif /* Cache_h */
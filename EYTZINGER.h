@@ -0,0 +1,341 @@
+#ifndef Eytzinger_h
+#define Eytzinger_h
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include <random>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include "BST.h"
+#include "MEMORY.h"
+#include "STATS.h"
+
+using namespace std;
+
+// Read-only ordered index built from the sorted contents of an AvlTree (or
+// anything with a sorted forEach). The keys are laid out in one array as an
+// implicit complete binary tree, so a search computes the next position
+// instead of loading a child pointer.
+//
+//   Eytzinger     breadth-first order: the children of position k are 2k and
+//                 2k + 1. The top levels share a few cache lines, and the
+//                 descendants four levels down sit next to each other, so they
+//                 are prefetched while the current level is compared.
+//   VanEmdeBoas   recursive order: the tree is cut at half its height and the
+//                 top half is laid out before every bottom half, each half the
+//                 same way. Any subtree of about a cache line (or a page) is
+//                 contiguous, whatever the line size. The tree is padded to
+//                 2^h - 1 positions with copies of the largest key.
+//
+// The search is a fixed number of steps with the comparison result used as
+// an index, so there is no branch to mispredict for keys whose comparison
+// compiles to a flag (integers). String keys still branch inside the
+// comparison, but the layout keeps their cache misses.
+template <class key, class value>
+class EytzingerIndex
+{
+  public:
+
+    enum Layout { Eytzinger, VanEmdeBoas };
+
+    EytzingerIndex( ) : layout( Eytzinger ), count( 0 ), height( 0 ), buildNanos( 0 ) { }
+
+    static const char * name( ) { return "EYT"; }
+
+    template <class Source>
+    void build( const Source & source, Layout how = Eytzinger ); // source.forEach(f(key, value)) in sorted order
+
+    const value * find( const key & x ) const; // nullptr if x is absent
+    size_t lowerBound( const key & x ) const; // rank of the first key not less than x, size() if none
+    const key & keyAt( size_t rank ) const { return keys[ slots[ rank ] ]; }
+    const value & valueAt( size_t rank ) const { return values[ slots[ rank ] ]; }
+    size_t size( ) const { return count; }
+    Layout currentLayout( ) const { return layout; }
+    long long buildTime( ) const { return buildNanos; }
+    MemoryReport memoryUsage( ) const;
+
+  private:
+
+    Layout layout;
+    size_t count;
+    int height; // Levels of the padded van Emde Boas tree
+    vector<key> keys; // In layout order, plus one position that means "none"
+    vector<value> values; // In layout order, next to the keys
+    vector<uint32_t> ranks; // Sorted rank of every position, count for padding and "none"
+    vector<uint32_t> slots; // Position of every rank
+    // Per depth of the van Emde Boas tree: the depth of the top tree the node's
+    // bottom tree hangs from, and the sizes of that top tree and of the bottom tree
+    vector<int> topDepth;
+    vector<size_t> topSize, bottomSize;
+    long long buildNanos;
+
+    // Levels between a position and the descendants it prefetches: as many as
+    // fit 2^levels keys in one cache line
+    static constexpr int PREFETCH_LEVELS = sizeof( key ) >= 32 ? 1 : sizeof( key ) >= 16 ? 2 : sizeof( key ) >= 8 ? 3 : 4;
+
+    size_t searchEytzinger( const key & x ) const;
+    size_t searchVanEmdeBoas( const key & x ) const;
+    size_t search( const key & x ) const;
+    void splitLevels( int depth, int levels );
+    template <class Entry>
+    void placeEytzinger( const vector<Entry> & sorted, size_t k, size_t & next );
+    template <class Entry>
+    void placeVanEmdeBoas( const vector<Entry> & sorted, size_t i, int depth, vector<size_t> & path, size_t & next );
+    template <class Entry>
+    void place( const vector<Entry> & sorted, size_t rank, size_t position );
+};
+
+/**
+ * Copy the sorted entries of source and lay them out.
+ * Positions past the last key (the "none" slot, van Emde Boas padding)
+ * hold copies of the largest entry with rank count.
+ */
+template <class key, class value>
+template <class Source>
+void EytzingerIndex<key, value>::build( const Source & source, Layout how )
+{
+    auto start = chrono::high_resolution_clock::now( );
+    vector<pair<key, value>> sorted;
+    source.forEach( [&]( const key & k, const value & v ) { sorted.emplace_back( k, v ); } );
+
+    layout = how;
+    count = sorted.size( );
+    height = 0;
+    keys.clear( );
+    values.clear( );
+    ranks.clear( );
+    slots.assign( count, 0 );
+    if ( count > 0 )
+    {
+        size_t positions = count + 1;    // Eytzinger leaves position 0 as "none"
+        if ( layout == VanEmdeBoas )
+        {
+            while ( ( size_t( 1 ) << height ) - 1 < count )
+                height++;
+            positions = ( size_t( 1 ) << height );    // 2^h - 1 tree positions, then "none"
+            topDepth.assign( height, 0 );
+            topSize.assign( height, 0 );
+            bottomSize.assign( height, 0 );
+            splitLevels( 0, height );
+        }
+        keys.assign( positions, sorted.back( ).first );
+        values.assign( positions, sorted.back( ).second );
+        ranks.assign( positions, uint32_t( count ) );
+
+        size_t next = 0;
+        if ( layout == Eytzinger )
+            placeEytzinger( sorted, 1, next );
+        else
+        {
+            vector<size_t> path( height );
+            placeVanEmdeBoas( sorted, 1, 0, path, next );
+        }
+    }
+    buildNanos = elapsedNanos( start );
+}
+
+template <class key, class value>
+template <class Entry>
+void EytzingerIndex<key, value>::place( const vector<Entry> & sorted, size_t rank, size_t position )
+{
+    if ( rank >= count )
+        return;    // padding keeps the copy of the largest entry
+    keys[ position ] = sorted[ rank ].first;
+    values[ position ] = sorted[ rank ].second;
+    ranks[ position ] = uint32_t( rank );
+    slots[ rank ] = uint32_t( position );
+}
+
+// In-order walk of the implicit tree, handing out the sorted entries
+template <class key, class value>
+template <class Entry>
+void EytzingerIndex<key, value>::placeEytzinger( const vector<Entry> & sorted, size_t k, size_t & next )
+{
+    if ( k > count )
+        return;
+    placeEytzinger( sorted, 2 * k, next );
+    place( sorted, next++, k );
+    placeEytzinger( sorted, 2 * k + 1, next );
+}
+
+// In-order walk of the complete tree by breadth-first index i, where path
+// holds the position of every node from the root down to depth
+template <class key, class value>
+template <class Entry>
+void EytzingerIndex<key, value>::placeVanEmdeBoas( const vector<Entry> & sorted, size_t i, int depth, vector<size_t> & path, size_t & next )
+{
+    if ( depth == height )
+        return;
+    path[ depth ] = depth == 0 ? 0 : path[ topDepth[ depth ] ] + topSize[ depth ] + ( i & topSize[ depth ] ) * bottomSize[ depth ];
+    size_t position = path[ depth ];
+    placeVanEmdeBoas( sorted, 2 * i, depth + 1, path, next );
+    place( sorted, next++, position );
+    placeVanEmdeBoas( sorted, 2 * i + 1, depth + 1, path, next );
+}
+
+/**
+ * Cut the levels [depth, depth + levels) into a top tree of levels / 2 and
+ * bottom trees of the rest, and recurse into both. The depth where the
+ * bottom trees start records where their top tree starts and both sizes,
+ * so a search finds the position of a node at that depth from its
+ * breadth-first index (Brodal, Fagerberg and Jacob's implicit navigation):
+ * the low bits of the index pick one of the bottom trees.
+ */
+template <class key, class value>
+void EytzingerIndex<key, value>::splitLevels( int depth, int levels )
+{
+    if ( levels <= 1 )
+        return;
+    int top = levels / 2, bottom = levels - top;
+    topDepth[ depth + top ] = depth;
+    topSize[ depth + top ] = ( size_t( 1 ) << top ) - 1;
+    bottomSize[ depth + top ] = ( size_t( 1 ) << bottom ) - 1;
+    splitLevels( depth, top );
+    splitLevels( depth + top, bottom );
+}
+
+/**
+ * Go right while the key is less than x. The path taken, read as the bits
+ * of k, ends in one 1 bit per right turn after the last left turn; dropping
+ * those and one more bit gives the node of the last left turn, the
+ * answer, or 0 when the search never turned left.
+ */
+template <class key, class value>
+size_t EytzingerIndex<key, value>::searchEytzinger( const key & x ) const
+{
+    const key * base = keys.data( );
+    size_t k = 1;
+    while ( k <= count )
+    {
+#if defined( __GNUC__ )
+        __builtin_prefetch( base + ( k << PREFETCH_LEVELS ) );
+#endif
+        k = 2 * k + ( base[ k ] < x );
+    }
+#if defined( __GNUC__ )
+    k >>= __builtin_ctzll( ~k ) + 1;
+#else
+    while ( k & 1 )
+        k >>= 1;
+    k >>= 1;
+#endif
+    return k;
+}
+
+// Keep the position of the last left turn while walking down every level
+template <class key, class value>
+size_t EytzingerIndex<key, value>::searchVanEmdeBoas( const key & x ) const
+{
+    size_t path[ 64 ];
+    size_t best = keys.size( ) - 1, i = 1;
+    path[ 0 ] = 0;
+    for ( int depth = 0; depth < height; depth++ )
+    {
+        if ( depth > 0 )
+            path[ depth ] = path[ topDepth[ depth ] ] + topSize[ depth ] + ( i & topSize[ depth ] ) * bottomSize[ depth ];
+        size_t position = path[ depth ];
+        size_t right = keys[ position ] < x;
+        best = right ? best : position;
+        i = 2 * i + right;
+    }
+    return best;
+}
+
+template <class key, class value>
+size_t EytzingerIndex<key, value>::search( const key & x ) const
+{
+    return layout == Eytzinger ? searchEytzinger( x ) : searchVanEmdeBoas( x );
+}
+
+template <class key, class value>
+size_t EytzingerIndex<key, value>::lowerBound( const key & x ) const
+{
+    return count == 0 ? 0 : ranks[ search( x ) ];
+}
+
+template <class key, class value>
+const value * EytzingerIndex<key, value>::find( const key & x ) const
+{
+    if ( count == 0 )
+        return nullptr;
+    size_t position = search( x );
+    size_t none = layout == Eytzinger ? 0 : keys.size( ) - 1;    // padding is never the answer, so ranks need not be read
+    if ( position == none || x < keys[ position ] )
+        return nullptr;
+    return &values[ position ];
+}
+
+template <class key, class value>
+MemoryReport EytzingerIndex<key, value>::memoryUsage( ) const
+{
+    MemoryReport report;
+    accountVector( keys, report.keyBytes, report );
+    for ( const key & k : keys )
+        report.keyBytes += heapBytes( k );
+    accountVector( values, report.postingBytes, report );
+    for ( const value & v : values )
+        accountMemory( v, report );
+    accountVector( ranks, report.nodeBytes, report );
+    accountVector( slots, report.nodeBytes, report );
+    return report;
+}
+
+// Function to compare lookups in an AvlTree of count random 64-bit keys,
+// built by inserts in random order, with both frozen layouts built from it
+// and with binary search over the sorted keys. Hits and misses alternate in
+// random order. lowerBound is checked against lower_bound on the sorted keys.
+inline void benchmarkLayouts(ostream & out, size_t count) {
+
+    mt19937_64 random(17);
+    vector<uint64_t> sorted(count);
+    for (uint64_t & k : sorted)
+        k = random() | 1; // odd keys, so k + 1 is never present
+    sort(sorted.begin(), sorted.end());
+    sorted.erase(unique(sorted.begin(), sorted.end()), sorted.end());
+    vector<uint64_t> probes;
+    for (uint64_t k : sorted) {
+        probes.push_back(k);
+        probes.push_back(k + 1);
+    }
+    shuffle(probes.begin(), probes.end(), random);
+
+    vector<uint64_t> shuffled = sorted;
+    shuffle(shuffled.begin(), shuffled.end(), random);
+    AvlTree<uint64_t, uint64_t> tree(0);
+    auto start = chrono::high_resolution_clock::now();
+    for (uint64_t k : shuffled)
+        tree.insert(k, k);
+    out << sorted.size() << " keys: AvlTree built by insert in " << elapsedNanos(start) / 1e6 << " ms" << endl;
+
+    uint64_t checksum = 0;
+    auto time = [&](const string & name, auto lookup) {
+        auto start = chrono::high_resolution_clock::now();
+        for (uint64_t k : probes)
+            checksum += lookup(k);
+        out << "  " << name << ": " << (double) elapsedNanos(start) / probes.size() << " ns per lookup" << endl;
+    };
+    time("AvlTree::find", [&](uint64_t k) { const uint64_t * v = tree.findValue(k); return v == nullptr ? 0 : *v; });
+    time("binary search", [&](uint64_t k) {
+        auto it = lower_bound(sorted.begin(), sorted.end(), k);
+        return it != sorted.end() && *it == k ? *it : 0;
+    });
+
+    for (auto layout : { EytzingerIndex<uint64_t, uint64_t>::Eytzinger, EytzingerIndex<uint64_t, uint64_t>::VanEmdeBoas }) {
+        EytzingerIndex<uint64_t, uint64_t> index;
+        index.build(tree, layout);
+        string name = layout == EytzingerIndex<uint64_t, uint64_t>::Eytzinger ? "Eytzinger" : "van Emde Boas";
+        size_t wrong = 0;
+        for (size_t i = 0; i < probes.size() && i < 100000; i++)
+            wrong += index.lowerBound(probes[i]) != size_t(lower_bound(sorted.begin(), sorted.end(), probes[i]) - sorted.begin());
+        out << "  " << name << " built in " << index.buildTime() / 1e6 << " ms, " << index.memoryUsage().total() / 1048576.0
+            << " MB" << (wrong > 0 ? ", LOWER BOUND WRONG" : "") << endl;
+        time(name + " find", [&](uint64_t k) { const uint64_t * v = index.find(k); return v == nullptr ? 0 : *v; });
+        time(name + " lowerBound", [&](uint64_t k) { return (uint64_t) index.lowerBound(k); });
+    }
+    out << "  (checksum " << checksum << ")" << endl;
+}
+
+#endif /* Eytzinger_h */
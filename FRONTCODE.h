@@ -0,0 +1,291 @@
+#ifndef FrontCode_h
+#define FrontCode_h
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <chrono>
+#include "INDEX.h"
+#include "MEMORY.h"
+#include "STATS.h"
+
+using namespace std;
+
+// Read-only sorted vocabulary stored with front coding. The sorted words are
+// cut into blocks of FRONT_CODE_BLOCK words. The first word of a block is
+// stored in full; every following word is stored as the length of the prefix
+// it shares with the word before it plus the remaining suffix. Lengths are
+// varint coded and all blocks share one byte array. A lookup binary searches
+// the first words of the blocks (the sampled index) and then decodes one
+// block. The position of a word in sorted order (its rank) is its id: the
+// word items are kept in an array in the same order.
+
+static const int FRONT_CODE_BLOCK = 16;
+
+class FrontCodedDictionary
+{
+  public:
+
+    FrontCodedDictionary( ) : words( 0 ), buildNanos( 0 ) { }
+
+    static const char * name( ) { return "FC"; }
+
+    template <class Backend>
+    void build( const Backend & source );
+
+    const WordItem * find( const string & word ) const;
+    int rank( const string & word ) const; // number of words less than word
+    string term( int rank ) const; // word with the given rank
+    template <class Function>
+    void forEachPrefix( const string & prefix, Function f ) const; // f(word, item) for words starting with prefix
+
+    int size( ) const { return words; }
+    long long buildTime( ) const { return buildNanos; }
+    MemoryReport memoryUsage( ) const;
+
+  private:
+
+    vector<unsigned char> bytes; // Front coded blocks
+    vector<uint32_t> blockOffsets; // Start of every block in bytes (the sampled index)
+    vector<WordItem> items; // Word item of every word, in sorted order
+    int words;
+    long long buildNanos;
+
+    static void putVarint( vector<unsigned char> & out, uint32_t x );
+    static uint32_t getVarint( const unsigned char *& p );
+    int compareHead( int block, const string & word ) const;
+    int findBlock( const string & word ) const;
+    int lowerBound( const string & word, bool & exact ) const;
+};
+
+inline void FrontCodedDictionary::putVarint( vector<unsigned char> & out, uint32_t x )
+{
+    while ( x >= 0x80 )
+    {
+        out.push_back( (unsigned char) ( x | 0x80 ) );
+        x >>= 7;
+    }
+    out.push_back( (unsigned char) x );
+}
+
+inline uint32_t FrontCodedDictionary::getVarint( const unsigned char *& p )
+{
+    uint32_t x = 0;
+    for ( int shift = 0; ; shift += 7 )
+    {
+        unsigned char byte = *p++;
+        x |= uint32_t( byte & 0x7f ) << shift;
+        if ( byte < 0x80 )
+            return x;
+    }
+}
+
+/**
+ * Encode the vocabulary of a live backend.
+ * The words arrive sorted from an in-order walk of the AVL tree; any other
+ * backend is sorted first.
+ */
+template <class Backend>
+void FrontCodedDictionary::build( const Backend & source )
+{
+    auto start = chrono::high_resolution_clock::now( );
+    vector<pair<string_view, const WordItem *>> sorted;
+    source.forEach( [&]( string_view word, const WordItem & item ) { sorted.push_back( { word, &item } ); } );
+    auto byWord = []( const pair<string_view, const WordItem *> & a, const pair<string_view, const WordItem *> & b ) {
+        return a.first < b.first;
+    };
+    if ( !is_sorted( sorted.begin( ), sorted.end( ), byWord ) )
+        sort( sorted.begin( ), sorted.end( ), byWord );
+
+    bytes.clear( );
+    blockOffsets.clear( );
+    items.clear( );
+    items.reserve( sorted.size( ) );
+    words = int( sorted.size( ) );
+
+    string_view previous;
+    for ( int i = 0; i < words; i++ )
+    {
+        string_view word = sorted[ i ].first;
+        if ( i % FRONT_CODE_BLOCK == 0 )
+        {
+            blockOffsets.push_back( uint32_t( bytes.size( ) ) );
+            putVarint( bytes, uint32_t( word.size( ) ) );
+            bytes.insert( bytes.end( ), word.begin( ), word.end( ) );
+        }
+        else
+        {
+            size_t shared = 0, limit = min( previous.size( ), word.size( ) );
+            while ( shared < limit && previous[ shared ] == word[ shared ] )
+                shared++;
+            putVarint( bytes, uint32_t( shared ) );
+            putVarint( bytes, uint32_t( word.size( ) - shared ) );
+            bytes.insert( bytes.end( ), word.begin( ) + shared, word.end( ) );
+        }
+        items.push_back( *sorted[ i ].second );
+        previous = word;
+    }
+    bytes.shrink_to_fit( );
+    blockOffsets.shrink_to_fit( );
+    buildNanos = elapsedNanos( start );
+}
+
+// Compare the first word of a block with word, like string::compare
+inline int FrontCodedDictionary::compareHead( int block, const string & word ) const
+{
+    const unsigned char * p = bytes.data( ) + blockOffsets[ block ];
+    uint32_t length = getVarint( p );
+    int result = memcmp( p, word.data( ), min<size_t>( length, word.size( ) ) );
+    if ( result != 0 )
+        return result;
+    return length < word.size( ) ? -1 : ( length > word.size( ) ? 1 : 0 );
+}
+
+/**
+ * Last block whose first word is not greater than word, -1 if word
+ * sorts before every stored word.
+ */
+inline int FrontCodedDictionary::findBlock( const string & word ) const
+{
+    int low = 0, high = int( blockOffsets.size( ) ) - 1, found = -1;
+    while ( low <= high )
+    {
+        int middle = ( low + high ) / 2;
+        if ( compareHead( middle, word ) <= 0 )
+        {
+            found = middle;
+            low = middle + 1;
+        }
+        else
+            high = middle - 1;
+    }
+    return found;
+}
+
+/**
+ * Return the item of word, nullptr if it is not in the vocabulary.
+ */
+inline const WordItem * FrontCodedDictionary::find( const string & word ) const
+{
+    bool exact = false;
+    int r = lowerBound( word, exact );
+    return exact ? &items[ r ] : nullptr;
+}
+
+inline int FrontCodedDictionary::rank( const string & word ) const
+{
+    bool exact = false;
+    return lowerBound( word, exact );
+}
+
+/**
+ * Rank of the first word not less than word; exact tells whether it is word.
+ * Binary search the block heads, then decode one block.
+ */
+inline int FrontCodedDictionary::lowerBound( const string & word, bool & exact ) const
+{
+    exact = false;
+    int block = findBlock( word );
+    if ( block < 0 )
+        return 0;
+
+    const unsigned char * p = bytes.data( ) + blockOffsets[ block ];
+    int first = block * FRONT_CODE_BLOCK, last = min( words, first + FRONT_CODE_BLOCK );
+    string current;
+    for ( int i = first; i < last; i++ )
+    {
+        if ( i == first )
+        {
+            uint32_t length = getVarint( p );
+            current.assign( (const char *) p, length );
+            p += length;
+        }
+        else
+        {
+            uint32_t shared = getVarint( p );
+            uint32_t length = getVarint( p );
+            current.resize( shared );
+            current.append( (const char *) p, length );
+            p += length;
+        }
+        int order = current.compare( word );
+        if ( order >= 0 )
+        {
+            exact = order == 0;
+            return i;
+        }
+    }
+    return last;
+}
+
+// Decode the word with the given rank
+inline string FrontCodedDictionary::term( int rank ) const
+{
+    if ( rank < 0 || rank >= words )
+        return "";
+    const unsigned char * p = bytes.data( ) + blockOffsets[ rank / FRONT_CODE_BLOCK ];
+    uint32_t length = getVarint( p );
+    string current( (const char *) p, length );
+    p += length;
+    for ( int i = rank % FRONT_CODE_BLOCK; i > 0; i-- )
+    {
+        uint32_t shared = getVarint( p );
+        length = getVarint( p );
+        current.resize( shared );
+        current.append( (const char *) p, length );
+        p += length;
+    }
+    return current;
+}
+
+/**
+ * The words with a prefix form one run in sorted order: start at the rank
+ * of the prefix and decode forward until a word no longer matches.
+ */
+template <class Function>
+void FrontCodedDictionary::forEachPrefix( const string & prefix, Function f ) const
+{
+    int i = rank( prefix );
+    if ( i == words )
+        return;
+    const unsigned char * p = bytes.data( ) + blockOffsets[ i / FRONT_CODE_BLOCK ];
+    string current;
+    for ( int j = i - i % FRONT_CODE_BLOCK; j < words; j++ )
+    {
+        if ( j % FRONT_CODE_BLOCK == 0 )
+        {
+            p = bytes.data( ) + blockOffsets[ j / FRONT_CODE_BLOCK ];
+            uint32_t length = getVarint( p );
+            current.assign( (const char *) p, length );
+            p += length;
+        }
+        else
+        {
+            uint32_t shared = getVarint( p );
+            uint32_t length = getVarint( p );
+            current.resize( shared );
+            current.append( (const char *) p, length );
+            p += length;
+        }
+        if ( j < i )
+            continue;
+        if ( current.compare( 0, prefix.size( ), prefix ) != 0 )
+            return;
+        f( current, items[ j ] );
+    }
+}
+
+inline MemoryReport FrontCodedDictionary::memoryUsage( ) const
+{
+    MemoryReport report;
+    accountVector( blockOffsets, report.nodeBytes, report );
+    accountVector( bytes, report.keyBytes, report );
+    accountVector( items, report.postingBytes, report );
+    for ( const WordItem & item : items )
+        accountMemory( item, report );
+    return report;
+}
+
+#endif /* FrontCode_h */
@@ -2,9 +2,13 @@
 #define Hash_h
 
 #include <string>
+#include <string_view>
 #include <cstddef>
 #include <vector>
 #include <iostream>
+#include <utility>
+#include "STATS.h"
+#include "MEMORY.h"
 
 using namespace std;
 
@@ -20,13 +24,24 @@ class HashTable
 
     const HashedObj & find( const HashedObj & x ) const;
     value getvalue(const HashedObj & x );
+    const value * findValue( const HashedObj & x ) const;
+    value * findValue( const HashedObj & x );
+    template <class Function>
+    void forEach( Function f ) const;    // call f(key, value) for every active entry
     void update(const HashedObj & x, const value & updated);
+    void update(const HashedObj & x, value && updated);
 
     void makeEmpty( );
     void insert( const HashedObj & x, const value & y);
+    void insert( HashedObj && x, value && y );    // moves x and y into the table
+    template <class K, class... Args>
+    void emplace( K && x, Args && ... args );    // constructs the value from args
     void remove( const HashedObj & x );
     const HashTable & operator=( const HashTable & rhs );
-    int output(float & load_ratio);
+    int output(float & load_ratio) const;
+    HashTableStats stats( ) const; // Snapshot of the hot-path counters
+    void resetStats( );
+    MemoryReport memoryUsage( ) const; // Bytes held by slots, keys and values
     
     enum EntryType { ACTIVE, EMPTY, DELETED };
   
@@ -41,6 +56,8 @@ class HashTable
          HashEntry( const value & theDetail = value(), const HashedObj & e = "",
                     EntryType i = EMPTY )
                   : details(theDetail), element( e ), info( i )  { }
+         HashEntry( value && theDetail, HashedObj && e, EntryType i = EMPTY )
+                  : element( std::move( e ) ), details( std::move( theDetail ) ), info( i )  { }
         
         void makeEmpty1() {
                 element = ""; // Reset the element
@@ -52,6 +69,7 @@ class HashTable
     vector<HashEntry> array;
     int currentSize;
     const HashedObj ITEM_NOT_FOUND;
+    SEARCH_STAT(mutable HashTableStats statistics;)
 
     bool isActive( int currentPos ) const;
     int findPos( const HashedObj & x ) const;
@@ -60,7 +78,7 @@ class HashTable
     int nextPrime( int n );
     void makeEmpty1();
    // int hash( const string & key, int tableSize ) const;
-    int hash( const string & key, int tableSize ) const;
+    int hash( string_view key, int tableSize ) const;
  };
   
 
@@ -81,7 +99,7 @@ HashTable<HashedObj, value>::HashTable( const HashedObj & notFound,
 // Hash function for strings
 
 template <class HashedObj, class value>
-int HashTable<HashedObj, value>::hash(const string& key, int table_size) const {
+int HashTable<HashedObj, value>::hash(string_view key, int table_size) const {
     
     static const size_t multiplier = 263; // A prime number
     static const size_t prime = 1000000007; // A large prime number
@@ -103,25 +121,93 @@ int HashTable<HashedObj, value>::findPos( const HashedObj & x ) const
        while ( array[ currentPos ].info != EMPTY &&
            array[ currentPos ].element != x )
        {
-            currentPos += pow(++collisionNum, 2) ;  //add the difference
+            currentPos += 2 * ++collisionNum - 1;  //add the difference
             if ( currentPos >= array.size( ) )              // perform the mod
                  currentPos -= array.size( );                // if necessary
        }
+       SEARCH_STAT(statistics.finds++;)
+       SEARCH_STAT(statistics.collisions += collisionNum;)
+       SEARCH_STAT(statistics.probeLengths.record(collisionNum);)
        return currentPos;
 }
 
 template <class HashedObj, class value>
-int HashTable<HashedObj, value>::output(float & load_ratio){
+int HashTable<HashedObj, value>::output(float & load_ratio) const {
     load_ratio = (float) currentSize / array.size();
     return currentSize;
 }
 
+/**
+ * Snapshot of the hot-path counters.
+ * All zero unless the program is built with SEARCH_STATS.
+ */
+template <class HashedObj, class value>
+HashTableStats HashTable<HashedObj, value>::stats( ) const
+{
+    HashTableStats snapshot;
+    SEARCH_STAT(snapshot = statistics;)
+    snapshot.tableSize = array.size( );
+    snapshot.words = currentSize;
+    snapshot.loadFactor = array.empty( ) ? 0 : (double) currentSize / array.size( );
+    return snapshot;
+}
+
+/**
+ * Walk the array and break its memory down by component.
+ * EMPTY and DELETED slots are reported separately from live entries.
+ */
+template <class HashedObj, class value>
+MemoryReport HashTable<HashedObj, value>::memoryUsage( ) const
+{
+    MemoryReport report;
+    report.slackBytes += ( array.capacity( ) - array.size( ) ) * sizeof( HashEntry );
+    addAllocation( report, array.capacity( ) * sizeof( HashEntry ) );
+
+    for ( int i = 0; i < array.size( ); i++ )
+    {
+        const HashEntry & entry = array[ i ];
+        if ( entry.info == EMPTY )
+        {
+            report.emptySlotBytes += sizeof( HashEntry );
+            continue;
+        }
+
+        MemoryReport owned;
+        owned.keyBytes += heapBytes( entry.element );
+        addAllocation( owned, heapBytes( entry.element ) );
+        accountMemory( entry.details, owned );
+
+        if ( entry.info == ACTIVE )
+        {
+            report.nodeBytes += sizeof( HashEntry );
+            report.keyBytes += owned.keyBytes;
+            report.postingBytes += owned.postingBytes;
+            report.slackBytes += owned.slackBytes;
+        }
+        else    // a tombstone still owns its old key and value
+            report.deletedSlotBytes += sizeof( HashEntry ) + owned.keyBytes
+                                     + owned.postingBytes + owned.slackBytes;
+
+        report.allocatorOverhead += owned.allocatorOverhead;
+        report.allocations += owned.allocations;
+    }
+    return report;
+}
+
+template <class HashedObj, class value>
+void HashTable<HashedObj, value>::resetStats( )
+{
+    SEARCH_STAT(long long tombstones = statistics.tombstones;)
+    SEARCH_STAT(statistics = HashTableStats();)
+    SEARCH_STAT(statistics.tombstones = tombstones;) // gauge, not a counter
+}
+
 template <class HashedObj, class value>
 bool check_document(value& temp, string file_name, int & idx){
     for (int i = 0; i < temp.details.size(); i++){
         if (temp.details[i].documentName == file_name){
             idx = i;
-            temp.details->documents[index].count += 1; // Increment count
+            temp.details->documents[idx].count += 1; // Increment count
             return true;
         }
     }
@@ -142,9 +228,21 @@ value HashTable<HashedObj, value>::getvalue(const HashedObj & x )  {
 template <class HashedObj, class value>
 void HashTable<HashedObj, value>::update(const HashedObj & x, const value & updated){
     
+    update( x, value( updated ) );
+}
+
+/**
+ * Replace the details of x, moving updated into the table.
+ * Insert x if it is not present.
+ */
+template <class HashedObj, class value>
+void HashTable<HashedObj, value>::update(const HashedObj & x, value && updated){
+    
     int currentPos = findPos( x );
-    array[ currentPos ].info = EMPTY;       
-    array[ currentPos ] = HashEntry( updated, x, ACTIVE );
+    if ( isActive( currentPos ) )
+        array[ currentPos ].details = std::move( updated );
+    else
+        emplace( x, std::move( updated ) );
 }
 /**
   * Return true if currentPos exists and is active.
@@ -162,8 +260,10 @@ template <class HashedObj, class value>
 void HashTable<HashedObj, value>::remove( const HashedObj & x )
 {
       int currentPos = findPos( x );
-      if ( isActive( currentPos ) )
+      if ( isActive( currentPos ) ) {
           array[ currentPos ].info = DELETED;
+          SEARCH_STAT(statistics.tombstones++;)
+      }
 }
 /**
  * Find item x in the hash table.
@@ -178,19 +278,75 @@ const HashedObj & HashTable<HashedObj, value>::find( const HashedObj & x ) const
 
      return   ITEM_NOT_FOUND;
 }
+/**
+ * Find the details stored for x without copying them.
+ * Return nullptr if x is not in the table.
+ */
+template <class HashedObj, class value>
+const value * HashTable<HashedObj, value>::findValue( const HashedObj & x ) const
+{
+     int currentPos = findPos( x );
+     if (isActive( currentPos ))
+          return &array[ currentPos ].details;
+
+     return nullptr;
+}
+/**
+ * Find the details stored for x so they can be updated in place.
+ * The pointer is invalidated by the next insert (which may rehash).
+ */
+template <class HashedObj, class value>
+value * HashTable<HashedObj, value>::findValue( const HashedObj & x )
+{
+     int currentPos = findPos( x );
+     if (isActive( currentPos ))
+          return &array[ currentPos ].details;
+
+     return nullptr;
+}
+/**
+ * Visit every active entry, in table order.
+ */
+template <class HashedObj, class value>
+template <class Function>
+void HashTable<HashedObj, value>::forEach( Function f ) const
+{
+     for ( int i = 0; i < array.size( ); i++ )
+          if ( isActive( i ) )
+               f( array[ i ].element, array[ i ].details );
+}
 /**
   * Insert item x into the hash table. If the item is
   * already present, then do nothing.
   */
 template <class HashedObj, class value>
  void HashTable<HashedObj, value>::insert( const HashedObj & x, const value & y)
+ {
+     emplace( x, y );
+ }
+/**
+  * Insert item x, moving the key and value into the table.
+  */
+template <class HashedObj, class value>
+ void HashTable<HashedObj, value>::insert( HashedObj && x, value && y )
+ {
+     emplace( std::move( x ), std::move( y ) );
+ }
+/**
+  * Insert item x with a value constructed from args.
+  * If the item is already present, then do nothing.
+  */
+template <class HashedObj, class value>
+template <class K, class... Args>
+ void HashTable<HashedObj, value>::emplace( K && x, Args && ... args )
  {
       // Insert x as active
       int currentPos = findPos( x );
      if ( isActive( currentPos ) )
          return;
+     SEARCH_STAT(if ( array[ currentPos ].info == DELETED ) statistics.tombstones--;)
          
-     array[ currentPos ] = HashEntry( y, x, ACTIVE );
+     array[ currentPos ] = HashEntry( value( std::forward<Args>( args )... ), HashedObj( std::forward<K>( x ) ), ACTIVE );
 
       // enlarge the hash table if necessary
      if (++currentSize >= 0.68 * array.size())
@@ -204,22 +360,26 @@ template <class HashedObj, class value>
 template <class HashedObj, class value>
 void HashTable<HashedObj, value>::rehash( )
 {
-    vector<HashEntry> oldArray = array;
-    cout << "rehashed..." << endl;
-    cout << "previous table size:" << oldArray.size() << ", new table size: " << nextPrime(2 * oldArray.size( )) << ",current unique word count " << currentSize << "," << endl;
-    float currentload = (float) currentSize / nextPrime(2 * oldArray.size( ));
-    cout << "current load factor: " << currentload << endl;
+    SEARCH_STAT(auto rehashStart = chrono::high_resolution_clock::now();)
+    vector<HashEntry> oldArray = std::move( array );
 
     // Create new double-sized, empty table
+    array.clear( );
     array.resize( nextPrime( 2 * oldArray.size( ) ) );
     for ( int j = 0; j < array.size( ); j++ )
          array[ j ].info = EMPTY;
 
-    // Copy table over
+    // Move table over
     currentSize = 0;
     for ( int i = 0; i < oldArray.size( ); i++ )
         if ( oldArray[ i ].info == ACTIVE )
-             insert( oldArray[ i ].element, oldArray[ i ].details );
+             insert( std::move( oldArray[ i ].element ), std::move( oldArray[ i ].details ) );
+
+    SEARCH_STAT(statistics.tombstones = 0;) // DELETED slots are not carried over
+    SEARCH_STAT(statistics.rehashes++;)
+    SEARCH_STAT(statistics.lastRehashNanos = elapsedNanos(rehashStart);)
+    SEARCH_STAT(statistics.rehashNanos += statistics.lastRehashNanos;)
+    SEARCH_STAT(if (statistics.lastRehashNanos > statistics.maxRehashNanos) statistics.maxRehashNanos = statistics.lastRehashNanos;)
 }
 /**
  * Internal method to test if a positive number is prime.
@@ -259,6 +419,8 @@ int HashTable<HashedObj, value>::nextPrime( int n )
 // Make the hash table logically empty.
 template <class HashedObj, class value>
 void HashTable<HashedObj, value>::makeEmpty( ){
+    currentSize = 0;
+    SEARCH_STAT(statistics.tombstones = 0;)
     for( int i = 0; i < array.size( ); i++ )
         array[ i ].makeEmpty1( );
 // destroy the lists but not the vector!
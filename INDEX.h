@@ -0,0 +1,81 @@
+#ifndef Index_h
+#define Index_h
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <algorithm>
+#include <cctype>
+#include "MEMORY.h"
+#include "POSTINGS.h"
+
+using namespace std;
+
+// Struct to represent a document item (the per-word posting layout before the posting store)
+struct DocumentItem {
+    
+    string documentName = "";
+    int count = 0; // Count of occurrences of a word in this document
+};
+
+// Struct to represent a word item
+struct WordItem {
+    
+    string_view word_name = ""; // The word itself, a view of its entry in the term pool
+    uint32_t termId = 0; // Id of the word in the term pool
+    PostingList documents; // Documents containing this word, set when the posting store is finalized
+};
+
+// Function to estimate the bytes the postings of a store would take as one
+// exactly sized vector<DocumentItem> per word, with the document names copied
+inline size_t vectorPostingBytes(const PostingStore & store) {
+
+    size_t bytes = 0;
+    for (uint32_t t = 0; t < store.terms(); t++) {
+        PostingList postings = store.list(t);
+        if (postings.empty())
+            continue;
+        size_t block = postings.size() * sizeof(DocumentItem);
+        bytes += sizeof(vector<DocumentItem>) + block + mallocOverhead(block);
+        for (size_t i = 0; i < postings.size(); i++) {
+            size_t name = documentName(postings.docId(i)).size();
+            if (name > string().capacity())
+                bytes += name + 1 + mallocOverhead(name + 1);
+        }
+    }
+    return bytes;
+}
+
+// Struct to represent word output
+struct WordOutput {
+    
+    string documentName; // Name of the document
+    string word; // Word
+    int count; // Count of occurrences of the word in the document
+};
+
+// Function to convert a string to lowercase
+inline string toLowercase(string &data) {
+    
+    transform(data.begin(), data.end(), data.begin(),
+                   [](unsigned char c) -> unsigned char { return std::tolower(c); });
+    return data;
+}
+
+// Function to remove punctuation and digits from a word
+inline void removePunctuationAndDigits(string& word, vector<string> &result) {
+    
+    string temp = "";
+    for (char letter : word) {
+        if (isalpha(letter)) {
+            temp += letter; // Append the character to the result string
+        }
+        else {
+            result.push_back(temp);
+            temp = "";
+        }
+    }
+    result.push_back(temp);
+}
+
+#endif /* Index_h */
@@ -0,0 +1,345 @@
+#ifndef Ingest_h
+#define Ingest_h
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <fstream>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <iostream>
+#include <cctype>
+#include <cstdint>
+#include "PIPELINE.h"
+#include "POSTINGS.h"
+#include "STATS.h"
+#include "AGGREGATE.h"
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+// Pipelined ingestion: reader threads, one tokenizer and one indexer, joined
+// by bounded single-producer single-consumer queues, so reading the next
+// file, splitting the current one and updating the dictionary overlap.
+//
+//   reader r (files r, r + R, ...) --blocks--> tokenizer --token batches--> indexer
+//
+// Every reader has its own queue and the tokenizer takes file i from reader
+// i % R, so documents reach the index in input order, as the posting store
+// requires. A full queue stops its producer (backpressure), which bounds the
+// memory in flight to the queue capacities.
+
+static const size_t INGEST_BLOCK_BYTES = 1 << 16; // bytes per read
+static const size_t INGEST_BATCH_TOKENS = 4096; // tokens per batch
+static const size_t INGEST_QUEUE_SLOTS = 64; // capacity of every queue
+
+/**
+ * Bounded lock-free ring for exactly one producer and one consumer. The
+ * producer owns tail and the consumer owns head; each only reads the other's
+ * index, so one acquire/release pair per operation is enough. The capacity
+ * is a power of two and one slot stays empty to tell full from empty.
+ */
+template <class T>
+class SpscQueue
+{
+  public:
+
+    explicit SpscQueue( size_t capacity );
+
+    bool tryPush( T & item ); // moves item in, false if full
+    bool tryPop( T & item ); // false if empty
+    void push( T & item, long long & waitNanos ); // waits while full
+    bool pop( T & item, long long & waitNanos ); // waits while empty, false once closed and drained
+    void close( ); // producer is done
+
+  private:
+
+    vector<T> slots;
+    size_t mask;
+    alignas( 64 ) atomic<size_t> head; // Next slot to pop
+    alignas( 64 ) atomic<size_t> tail; // Next slot to push
+    atomic<bool> closed;
+
+    static void pause( int & spins );
+};
+
+template <class T>
+SpscQueue<T>::SpscQueue( size_t capacity ) : head( 0 ), tail( 0 ), closed( false )
+{
+    size_t size = 2;
+    while ( size < capacity + 1 )
+        size *= 2;
+    slots.resize( size );
+    mask = size - 1;
+}
+
+// Spin briefly, then give the core away: a stage waiting on its neighbour
+// may share the core with it
+template <class T>
+void SpscQueue<T>::pause( int & spins )
+{
+    if ( ++spins > 64 )
+        this_thread::yield( );
+}
+
+template <class T>
+bool SpscQueue<T>::tryPush( T & item )
+{
+    size_t t = tail.load( memory_order_relaxed );
+    if ( ( ( t + 1 ) & mask ) == head.load( memory_order_acquire ) )
+        return false;
+    slots[ t ] = std::move( item );
+    tail.store( ( t + 1 ) & mask, memory_order_release );
+    return true;
+}
+
+template <class T>
+bool SpscQueue<T>::tryPop( T & item )
+{
+    size_t h = head.load( memory_order_relaxed );
+    if ( h == tail.load( memory_order_acquire ) )
+        return false;
+    item = std::move( slots[ h ] );
+    head.store( ( h + 1 ) & mask, memory_order_release );
+    return true;
+}
+
+template <class T>
+void SpscQueue<T>::push( T & item, long long & waitNanos )
+{
+    if ( tryPush( item ) )
+        return;
+    auto start = chrono::high_resolution_clock::now( );
+    for ( int spins = 0; !tryPush( item ); )
+        pause( spins );
+    waitNanos += elapsedNanos( start );
+}
+
+template <class T>
+bool SpscQueue<T>::pop( T & item, long long & waitNanos )
+{
+    if ( tryPop( item ) )
+        return true;
+    auto start = chrono::high_resolution_clock::now( );
+    for ( int spins = 0; ; pause( spins ) )
+    {
+        bool done = closed.load( memory_order_acquire ); // read before the last look
+        if ( tryPop( item ) )
+            break;
+        if ( done )
+        {
+            waitNanos += elapsedNanos( start );
+            return false;
+        }
+    }
+    waitNanos += elapsedNanos( start );
+    return true;
+}
+
+template <class T>
+void SpscQueue<T>::close( )
+{
+    closed.store( true, memory_order_release );
+}
+
+// A piece of one input file; the last piece of a file has last set
+struct FileBlock {
+
+    size_t file = 0; // Position of the file in the input list
+    string bytes;
+    bool last = false;
+};
+
+// Tokens of one document, stored back to back in text
+struct TokenBatch {
+
+    uint32_t document = 0;
+    string text;
+    vector<uint32_t> ends; // Token i is text[ends[i - 1], ends[i])
+    vector<uint32_t> counts; // Occurrences of token i, empty when every token counts once
+};
+
+// Struct to hold where one stage spent its time
+struct StageTimes {
+
+    string name;
+    long long wall = 0; // Life of the stage's thread
+    long long inputWait = 0; // Waiting for an empty queue to fill
+    long long outputWait = 0; // Waiting for a full queue to drain (backpressure)
+
+    long long busy() const { return wall - inputWait - outputWait; }
+};
+
+// Function to read files into blocks with pread, one reader thread per call
+inline void readFiles(const vector<string> & files, size_t first, size_t step, SpscQueue<FileBlock> & out, StageTimes & times) {
+
+    auto start = chrono::high_resolution_clock::now();
+    for (size_t i = first; i < files.size(); i += step) {
+        FileBlock block;
+#ifdef __linux__
+        int fd = open(files[i].c_str(), O_RDONLY);
+        off_t offset = 0;
+        while (fd >= 0) {
+            block.file = i;
+            block.bytes.resize(INGEST_BLOCK_BYTES);
+            ssize_t n = pread(fd, &block.bytes[0], INGEST_BLOCK_BYTES, offset);
+            if (n <= 0)
+                break;
+            block.bytes.resize(n);
+            offset += n;
+            out.push(block, times.outputWait);
+            block = FileBlock();
+        }
+        if (fd >= 0)
+            close(fd);
+#else
+        ifstream file(files[i], ios::binary);
+        block.file = i;
+        while (file) {
+            block.bytes.resize(INGEST_BLOCK_BYTES);
+            file.read(&block.bytes[0], INGEST_BLOCK_BYTES);
+            block.bytes.resize(file.gcount());
+            if (block.bytes.empty())
+                break;
+            out.push(block, times.outputWait);
+            block = FileBlock();
+            block.file = i;
+        }
+#endif
+        block.file = i;
+        block.bytes.clear();
+        block.last = true;
+        out.push(block, times.outputWait);
+    }
+    out.close();
+    times.wall = elapsedNanos(start);
+}
+
+// Function to split blocks into lowercase tokens. A token is a maximal run of
+// letters: the same words addDocument() gets from splitting on whitespace,
+// lowercasing and cutting at punctuation and digits. A token cut by a block
+// boundary is carried into the next block. With aggregate set, the tokens of
+// a document are counted here and every batch holds distinct words with
+// their counts, which takes that work off the indexer.
+inline void tokenizeBlocks(vector<unique_ptr<SpscQueue<FileBlock>>> & in, const vector<uint32_t> & documents, bool aggregate,
+                           SpscQueue<TokenBatch> & out, StageTimes & times) {
+
+    auto start = chrono::high_resolution_clock::now();
+    FileBlock block;
+    TokenBatch batch;
+    DocumentTerms terms;
+    string token; // Letters of the token being read
+
+    auto endToken = [&]() {
+        if (aggregate)
+            terms.add(token);
+        else {
+            batch.text += token;
+            batch.ends.push_back(uint32_t(batch.text.size()));
+        }
+        token.clear();
+    };
+    auto sendBatch = [&](uint32_t document) {
+        terms.forEach([&](string_view word, uint32_t count) {
+            batch.text.append(word.data(), word.size());
+            batch.ends.push_back(uint32_t(batch.text.size()));
+            batch.counts.push_back(count);
+        });
+        terms.clear();
+        batch.document = document;
+        if (!batch.ends.empty())
+            out.push(batch, times.outputWait);
+        batch = TokenBatch();
+    };
+
+    for (size_t i = 0; i < documents.size(); i++) {
+
+        SpscQueue<FileBlock> & source = *in[i % in.size()];
+        token.clear();
+        do {
+            if (!source.pop(block, times.inputWait))
+                break;
+            for (char c : block.bytes) {
+                if (isalpha((unsigned char) c))
+                    token += (char) tolower((unsigned char) c);
+                else if (!token.empty())
+                    endToken();
+            }
+            if (block.last && !token.empty())
+                endToken();
+            if (block.last || batch.ends.size() >= INGEST_BATCH_TOKENS || terms.size() >= INGEST_BATCH_TOKENS * 16)
+                sendBatch(documents[i]);
+        } while (!block.last);
+    }
+    out.close();
+    times.wall = elapsedNanos(start);
+}
+
+// Function to apply token batches to the index, in order
+template <class Backend>
+void indexBatches(SearchIndex<Backend> & index, SpscQueue<TokenBatch> & in, StageTimes & times) {
+
+    auto start = chrono::high_resolution_clock::now();
+    TokenBatch batch;
+    while (in.pop(batch, times.inputWait)) {
+        uint32_t begin = 0;
+        for (size_t i = 0; i < batch.ends.size(); i++) {
+            uint32_t count = batch.counts.empty() ? 1 : batch.counts[i];
+            index.addWord(string_view(batch.text).substr(begin, batch.ends[i] - begin), batch.document, count);
+            begin = batch.ends[i];
+        }
+    }
+    times.wall = elapsedNanos(start);
+}
+
+// Function to ingest files into an index through the pipeline with the given
+// number of reader threads, the indexer running on the calling thread. The
+// index is not finalized. Returns the time of every stage.
+template <class Backend>
+vector<StageTimes> ingestPipelined(SearchIndex<Backend> & index, const vector<string> & files, int readers) {
+
+    readers = max(1, min(readers, (int) max<size_t>(files.size(), 1)));
+    vector<uint32_t> documents;
+    for (const string & file : files)
+        documents.push_back(sharedDocumentNames().intern(file)); // interning is not thread safe
+
+    auto start = chrono::high_resolution_clock::now();
+    vector<unique_ptr<SpscQueue<FileBlock>>> blocks;
+    for (int r = 0; r < readers; r++)
+        blocks.emplace_back(new SpscQueue<FileBlock>(INGEST_QUEUE_SLOTS));
+    SpscQueue<TokenBatch> batches(INGEST_QUEUE_SLOTS);
+    vector<StageTimes> times(readers + 2);
+
+    vector<thread> threads;
+    for (int r = 0; r < readers; r++) {
+        times[r].name = "reader " + to_string(r);
+        threads.emplace_back([&, r] { readFiles(files, r, readers, *blocks[r], times[r]); });
+    }
+    times[readers].name = "tokenizer";
+    threads.emplace_back([&] { tokenizeBlocks(blocks, documents, index.aggregates(), batches, times[readers]); });
+    times[readers + 1].name = "indexer";
+    indexBatches(index, batches, times[readers + 1]);
+    for (thread & worker : threads)
+        worker.join();
+    index.addIngestionTime(elapsedNanos(start));
+    return times;
+}
+
+// Function to print the share of its life every stage spent working and waiting
+inline void printStageTimes(ostream & out, const string & name, const vector<StageTimes> & times) {
+
+    for (const StageTimes & stage : times) {
+        double wall = stage.wall > 0 ? (double) stage.wall : 1;
+        out << name << " " << stage.name << ": " << stage.wall / 1e6 << " ms, busy " << 100 * stage.busy() / wall
+            << "%, waiting for input " << 100 * stage.inputWait / wall << "%, blocked on output "
+            << 100 * stage.outputWait / wall << "%" << endl;
+    }
+}
+
+#endif /* Ingest_h */
@@ -0,0 +1,94 @@
+#ifndef Memory_h
+#define Memory_h
+
+#include <string>
+#include <cstddef>
+#include <vector>
+#include <iostream>
+#include <iomanip>
+
+using namespace std;
+
+// Breakdown of the memory held by one index structure, in bytes.
+// The numbers are computed by walking the structure, not by asking the
+// allocator, so they are exact for object sizes and estimated for the
+// per-allocation bookkeeping of malloc.
+struct MemoryReport {
+
+    size_t nodeBytes = 0; // AvlNode objects or ACTIVE HashEntry slots
+    size_t emptySlotBytes = 0; // EMPTY HashEntry slots
+    size_t deletedSlotBytes = 0; // DELETED HashEntry slots and what they still own
+    size_t keyBytes = 0; // Heap storage of key strings (including copies inside values)
+    size_t postingBytes = 0; // Posting objects and the heap storage they own
+    size_t slackBytes = 0; // Reserved but unused vector capacity
+    size_t allocatorOverhead = 0; // Estimated malloc headers and rounding
+    size_t allocations = 0; // Number of live heap blocks
+
+    size_t total() const {
+        return nodeBytes + emptySlotBytes + deletedSlotBytes + keyBytes
+            + postingBytes + slackBytes + allocatorOverhead;
+    }
+};
+
+// Estimated bookkeeping cost of one malloc'ed block of n bytes
+// (glibc: 8 byte header, 16 byte alignment, 32 byte minimum chunk).
+inline size_t mallocOverhead(size_t n) {
+    size_t chunk = (n + 8 + 15) & ~size_t(15);
+    if (chunk < 32)
+        chunk = 32;
+    return chunk - n;
+}
+
+// Record one heap block of n bytes
+inline void addAllocation(MemoryReport & report, size_t n) {
+    if (n == 0)
+        return;
+    report.allocations++;
+    report.allocatorOverhead += mallocOverhead(n);
+}
+
+// Heap bytes owned by a string (zero when it fits the small string buffer)
+inline size_t heapBytes(const string & s) {
+    static const size_t inlineCapacity = string().capacity();
+    return s.capacity() > inlineCapacity ? s.capacity() + 1 : 0;
+}
+
+// Types that own no heap memory
+template <class T>
+size_t heapBytes(const T &) {
+    return 0;
+}
+
+// Add the heap memory owned by a stored value to the report.
+// Value types that own memory provide an overload of this function
+// next to their definition; it is found through argument dependent lookup.
+template <class T>
+void accountMemory(const T &, MemoryReport &) {}
+
+// Add a vector's buffer to the report: used elements go to 'used', the rest is slack
+template <class T>
+void accountVector(const vector<T> & vec, size_t & used, MemoryReport & report) {
+    used += vec.size() * sizeof(T);
+    report.slackBytes += (vec.capacity() - vec.size()) * sizeof(T);
+    addAllocation(report, vec.capacity() * sizeof(T));
+}
+
+// Print the report of one structure
+inline void printMemoryReport(ostream & out, const string & name, const MemoryReport & report) {
+
+    const double MB = 1024.0 * 1024.0;
+    out << fixed << setprecision(2);
+    out << name << " memory: " << report.total() / MB << " MB in " << report.allocations << " allocations" << endl;
+    out << "  nodes/slots:        " << report.nodeBytes / MB << " MB" << endl;
+    if (report.emptySlotBytes != 0 || report.deletedSlotBytes != 0) {
+        out << "  empty slots:        " << report.emptySlotBytes / MB << " MB" << endl;
+        out << "  deleted slots:      " << report.deletedSlotBytes / MB << " MB" << endl;
+    }
+    out << "  key bytes:          " << report.keyBytes / MB << " MB" << endl;
+    out << "  posting bytes:      " << report.postingBytes / MB << " MB" << endl;
+    out << "  vector slack:       " << report.slackBytes / MB << " MB" << endl;
+    out << "  allocator overhead: " << report.allocatorOverhead / MB << " MB" << endl;
+    out << defaultfloat << setprecision(6);
+}
+
+#endif /* Memory_h */
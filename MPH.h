@@ -0,0 +1,234 @@
+#ifndef MPH_h
+#define MPH_h
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <chrono>
+#include "INDEX.h"
+#include "MEMORY.h"
+#include "STATS.h"
+
+using namespace std;
+
+// Read-only dictionary built over a finished vocabulary with a minimal
+// perfect hash function (PTHash style). Every key hashes once to a 64-bit
+// value h. h selects a bucket, the bucket's pilot p was chosen at build time
+// so that slot (h ^ mix(p)) mod n is unique for every key, and the key
+// stored in that slot is compared once to reject words outside the
+// vocabulary. There is no probing, no load headroom and no tombstone.
+// Keys are packed into one byte array and the word items into one array,
+// both in slot order.
+class FrozenDictionary
+{
+  public:
+
+    FrozenDictionary( ) : seed( 0 ), bucketCount( 0 ), buildNanos( 0 ) { }
+
+    static const char * name( ) { return "MPH"; }
+
+    template <class Backend>
+    void build( const Backend & source );
+
+    const WordItem * find( const string & word ) const;
+    int size( ) const { return int( items.size( ) ); }
+    double bitsPerKey( ) const;    // size of the hash function itself (the pilots)
+    long long buildTime( ) const { return buildNanos; }
+    MemoryReport memoryUsage( ) const;
+
+  private:
+
+    vector<uint32_t> pilots; // One per bucket
+    vector<uint32_t> keyOffsets; // keyBytes[keyOffsets[i], keyOffsets[i + 1]) is the key in slot i
+    vector<char> keyBytes;
+    vector<WordItem> items; // Word item in slot i
+    uint64_t seed;
+    uint64_t bucketCount;
+    long long buildNanos;
+
+    static uint64_t mix( uint64_t x );
+    static uint64_t hashKey( const string & key, uint64_t seed );
+    uint64_t bucketOf( uint64_t h ) const { return ( ( h >> 32 ) * bucketCount ) >> 32; }
+    static uint64_t slotOf( uint64_t h, uint32_t pilot, uint64_t n ) { return ( h ^ mix( pilot ) ) % n; }
+    bool search( const vector<string> & keys, uint64_t trySeed );
+};
+
+// 64-bit finalizer from MurmurHash3
+inline uint64_t FrozenDictionary::mix( uint64_t x )
+{
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+// Seeded FNV-1a over the key bytes, finished with mix()
+inline uint64_t FrozenDictionary::hashKey( const string & key, uint64_t seed )
+{
+    uint64_t h = 0xcbf29ce484222325ULL ^ mix( seed + 1 );
+    for ( unsigned char c : key )
+    {
+        h ^= c;
+        h *= 0x100000001b3ULL;
+    }
+    return mix( h );
+}
+
+/**
+ * Freeze the vocabulary of a live backend.
+ * Retries with a new seed in the (rare) case a pilot search fails.
+ */
+template <class Backend>
+void FrozenDictionary::build( const Backend & source )
+{
+    auto start = chrono::high_resolution_clock::now( );
+    vector<string> keys;
+    vector<const WordItem *> sourceItems;
+    source.forEach( [&]( string_view word, const WordItem & item ) {
+        keys.push_back( string( word ) );
+        sourceItems.push_back( &item );
+    } );
+
+    pilots.clear( );
+    keyOffsets.assign( 1, 0 );
+    keyBytes.clear( );
+    items.clear( );
+
+    uint64_t n = keys.size( );
+    if ( n > 0 )
+    {
+        // About 5 / log2(n) buckets per key: average bucket size grows slowly with n
+        bucketCount = max<uint64_t>( 1, uint64_t( ceil( 5.0 * n / max( 1.0, log2( double( n ) ) ) ) ) );
+        for ( seed = 0; !search( keys, seed ); seed++ )
+            ;
+
+        vector<uint32_t> slotKey( n );
+        for ( uint32_t i = 0; i < n; i++ )
+        {
+            uint64_t h = hashKey( keys[ i ], seed );
+            slotKey[ slotOf( h, pilots[ bucketOf( h ) ], n ) ] = i;
+        }
+
+        items.resize( n );
+        keyOffsets.resize( n + 1 );
+        for ( uint64_t slot = 0; slot < n; slot++ )
+        {
+            const string & key = keys[ slotKey[ slot ] ];
+            keyBytes.insert( keyBytes.end( ), key.begin( ), key.end( ) );
+            keyOffsets[ slot + 1 ] = uint32_t( keyBytes.size( ) );
+            items[ slot ] = *sourceItems[ slotKey[ slot ] ];
+        }
+        keyBytes.shrink_to_fit( );
+    }
+    buildNanos = elapsedNanos( start );
+}
+
+/**
+ * Find pilots for every bucket, largest buckets first.
+ * Return false if this seed cannot produce a perfect hash.
+ */
+inline bool FrozenDictionary::search( const vector<string> & keys, uint64_t trySeed )
+{
+    uint64_t n = keys.size( );
+    vector<uint64_t> hashes( n );
+    vector<uint32_t> bucketSize( bucketCount + 1, 0 );
+    for ( uint64_t i = 0; i < n; i++ )
+    {
+        hashes[ i ] = hashKey( keys[ i ], trySeed );
+        bucketSize[ ( ( hashes[ i ] >> 32 ) * bucketCount ) >> 32 ]++;
+    }
+
+    // Group the keys by bucket (counting sort)
+    vector<uint32_t> bucketStart( bucketCount + 1, 0 );
+    for ( uint64_t b = 0; b < bucketCount; b++ )
+        bucketStart[ b + 1 ] = bucketStart[ b ] + bucketSize[ b ];
+    vector<uint32_t> members( n );
+    vector<uint32_t> fill( bucketStart.begin( ), bucketStart.end( ) - 1 );
+    for ( uint32_t i = 0; i < n; i++ )
+        members[ fill[ ( ( hashes[ i ] >> 32 ) * bucketCount ) >> 32 ]++ ] = i;
+
+    vector<uint32_t> order( bucketCount );
+    for ( uint32_t b = 0; b < bucketCount; b++ )
+        order[ b ] = b;
+    stable_sort( order.begin( ), order.end( ), [&]( uint32_t a, uint32_t b ) { return bucketSize[ a ] > bucketSize[ b ]; } );
+
+    seed = trySeed;
+    pilots.assign( bucketCount, 0 );
+    vector<bool> taken( n, false );
+    vector<uint64_t> slots;
+    for ( uint32_t b : order )
+    {
+        if ( bucketSize[ b ] == 0 )
+            break;
+
+        const uint32_t * first = &members[ bucketStart[ b ] ];
+        for ( uint32_t i = 1; i < bucketSize[ b ]; i++ )
+            for ( uint32_t j = 0; j < i; j++ )
+                if ( hashes[ first[ i ] ] == hashes[ first[ j ] ] )
+                    return false;    // two keys with the same 64-bit hash can never be separated
+
+        bool placed = false;
+        for ( uint64_t pilot = 0; !placed && pilot < 64 * n + 1024; pilot++ )
+        {
+            slots.clear( );
+            for ( uint32_t i = 0; i < bucketSize[ b ]; i++ )
+            {
+                uint64_t slot = slotOf( hashes[ first[ i ] ], uint32_t( pilot ), n );
+                if ( taken[ slot ] || std::find( slots.begin( ), slots.end( ), slot ) != slots.end( ) )
+                    break;
+                slots.push_back( slot );
+            }
+            if ( slots.size( ) == bucketSize[ b ] )
+            {
+                for ( uint64_t slot : slots )
+                    taken[ slot ] = true;
+                pilots[ b ] = uint32_t( pilot );
+                placed = true;
+            }
+        }
+        if ( !placed )
+            return false;
+    }
+    return true;
+}
+
+/**
+ * One hash, one pilot read and one key compare.
+ * Return nullptr if word is not in the frozen vocabulary.
+ */
+inline const WordItem * FrozenDictionary::find( const string & word ) const
+{
+    uint64_t n = items.size( );
+    if ( n == 0 )
+        return nullptr;
+    uint64_t h = hashKey( word, seed );
+    uint64_t slot = slotOf( h, pilots[ bucketOf( h ) ], n );
+    uint32_t begin = keyOffsets[ slot ], length = keyOffsets[ slot + 1 ] - begin;
+    if ( length != word.size( ) || memcmp( keyBytes.data( ) + begin, word.data( ), length ) != 0 )
+        return nullptr;
+    return &items[ slot ];
+}
+
+inline double FrozenDictionary::bitsPerKey( ) const
+{
+    return items.empty( ) ? 0.0 : 32.0 * pilots.size( ) / items.size( );
+}
+
+inline MemoryReport FrozenDictionary::memoryUsage( ) const
+{
+    MemoryReport report;
+    accountVector( pilots, report.nodeBytes, report );
+    accountVector( keyOffsets, report.nodeBytes, report );
+    accountVector( keyBytes, report.keyBytes, report );
+    accountVector( items, report.postingBytes, report );
+    for ( const WordItem & item : items )
+        accountMemory( item, report );
+    return report;
+}
+
+#endif /* MPH_h */
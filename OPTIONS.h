@@ -0,0 +1,209 @@
+#ifndef Options_h
+#define Options_h
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <thread>
+#include <algorithm>
+#include <cctype>
+#include <sstream>
+
+using namespace std;
+
+// Struct to hold the command line options
+struct SearchOptions {
+
+    vector<string> files; // --files <file>...: documents to index instead of asking on stdin
+    string queryLog; // --queries <log>: replay the log non-interactively and exit
+    string backend = "both"; // --backend <name>|both, names as printed in the reports
+    int concurrency = 1; // --concurrency <threads> for the replay
+    bool useCache = false; // --cache: serve replayed queries through the result cache
+    string batchLog; // --batch-bench <query log>: measure batched query throughput and exit
+    string parallelLog; // --parallel-bench <query log>: compare serial and intra-query parallel evaluation
+    int queryThreads = max(1, (int) thread::hardware_concurrency()); // --query-threads <threads> for one query
+    string shardLog; // --shard-bench <query log>: build sharded indexes and time the log against them
+    vector<int> shardCounts = { 1, 2, 4, 8 }; // --shards <n,...>
+    bool shardProcesses = false; // --shard-mode threads|processes
+    string shardPrefix; // --shard-prefix <path>: save every shard to <path>-<backend>-<i>-of-<n>.idx
+    string viewLog; // --view-bench <query log>: time materialized answers against query views and exit
+    string cacheLog; // --cache-bench <query log>: replay a Zipfian sample through the query cache and exit
+    size_t cacheBudget = 1 << 20; // --cache-budget <bytes>
+    bool lookupBench = false; // --lookup-bench: time hit and miss lookups over the vocabulary in every structure
+    bool aggregate = true; // --no-aggregate: send every token to the dictionary instead of each document's distinct words
+    int pipelineReaders = 0; // --pipeline <readers>: ingest through the reader/tokenizer/indexer pipeline
+    size_t spillBudget = 0; // --spill-budget <bytes>: ingest in runs of that much memory, spilled to disk and merged
+    string spillPrefix = "spill"; // --spill-prefix <path>: runs go to <path>-<backend>-run-<i>.idx
+    vector<size_t> spillBench; // --spill-bench <bytes,...>: ingestion throughput and peak memory at each budget, then exit
+    double allocationBudget = 0; // --alloc-budget <allocations>: fail if ingestion makes more allocations per token
+    size_t internReport = 0; // --intern-report <terms>: memory of that many terms with and without the term pool, then exit
+    size_t bulkBench = 0; // --bulk-bench <words>: build an AVL tree of that many words by insert and by bulkLoad, then exit
+    size_t rankBench = 0; // --rank-bench <words>: AvlTree rank, select and range queries against in-order walks, then exit
+    size_t swissBench = 0; // --swiss-bench <words>: HashTable against SwissTable at several load factors, then exit
+    vector<size_t> layoutBench; // --layout-bench <keys,...>: AvlTree lookups against the Eytzinger and vEB layouts, then exit
+    bool trace = false; // --trace: time every phase of interactive queries and print the histograms at exit
+    string traceJson; // --trace-json <path>: also write the phase timings as a Chrome trace
+    double bloomRate = 0; // --bloom <rate>: guard every lookup with a Bloom filter of that false positive rate
+    bool freeze = false; // --freeze: build the read-only dictionaries (MPH and FC) after preprocessing
+    int servePort = 0; // --serve <port>: answer queries on 127.0.0.1:<port>
+    string serveUnix; // --serve-unix <path>: answer queries on a Unix-domain socket
+    int workers = max(1, (int) thread::hardware_concurrency()); // --workers <threads> of the server
+
+    bool serving() const {
+        return servePort > 0 || serveUnix != "";
+    }
+
+    // Whether the backend with this display name takes part (names match case-insensitively)
+    bool uses(string name) const {
+        transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return (char) tolower(c); });
+        string wanted = backend;
+        transform(wanted.begin(), wanted.end(), wanted.begin(), [](unsigned char c) { return (char) tolower(c); });
+        return wanted == "both" || wanted == name;
+    }
+};
+
+// Function to print the command line synopsis
+inline void printUsage(ostream & out, const string & program) {
+
+    out << "Usage: " << program << " [options]" << endl;
+    out << "  --files <file>...          index these files instead of asking on stdin" << endl;
+    out << "  --queries <log>            replay the query log without prompts and report QPS" << endl;
+    out << "  --backend <name>|both      structures to use, e.g. bst or hash (default both); mph and fc need --freeze --serve" << endl;
+    out << "  --concurrency <threads>    replay threads (default 1)" << endl;
+    out << "  --cache                    serve replayed queries through the result cache" << endl;
+    out << "  --batch-bench <log>        measure batched query throughput" << endl;
+    out << "  --parallel-bench <log>     compare serial and parallel evaluation of each query" << endl;
+    out << "  --query-threads <threads>  threads working on one query (default: one per core)" << endl;
+    out << "  --shard-bench <log>        build sharded indexes and time the log against them" << endl;
+    out << "  --shards <n,...>           shard counts of the shard bench (default 1,2,4,8)" << endl;
+    out << "  --shard-mode <mode>        threads (default) or processes" << endl;
+    out << "  --shard-prefix <path>      save the shards and query the reloaded copy" << endl;
+    out << "  --view-bench <log>         compare materialized answers with query views per query" << endl;
+    out << "  --cache-bench <log>        replay a Zipfian sample with and without the cache" << endl;
+    out << "  --cache-budget <bytes>     result cache size (default 1 MB)" << endl;
+    out << "  --lookup-bench             time hit and miss lookups over the whole vocabulary" << endl;
+    out << "  --no-aggregate             add every token to the dictionary, not each document's word counts" << endl;
+    out << "  --pipeline <readers>       ingest through a reader, tokenizer and indexer pipeline" << endl;
+    out << "  --spill-budget <bytes>     ingest in runs of at most that much memory, spilled to disk and merged" << endl;
+    out << "  --spill-prefix <path>      where the runs and the merged index go (default spill)" << endl;
+    out << "  --spill-bench <bytes,...>  ingestion throughput and peak memory at each budget (0: no limit) and exit" << endl;
+    out << "  --alloc-budget <n>         exit with status 1 if ingestion allocates more than n times per token" << endl;
+    out << "  --intern-report <terms>    compare string copies with the term pool on that many terms and exit" << endl;
+    out << "  --bulk-bench <words>       compare AVL insert with bulkLoad on that many random words and exit" << endl;
+    out << "  --rank-bench <words>       compare AvlTree rank, select and range sums with in-order walks and exit" << endl;
+    out << "  --swiss-bench <words>      compare HASH with SWISS at load factors 0.25 to 0.875 and exit" << endl;
+    out << "  --layout-bench <keys,...>  compare AvlTree lookups with the Eytzinger and vEB layouts and exit" << endl;
+    out << "  --trace                    time the phases of every query; TRACE or the end of input prints them" << endl;
+    out << "  --trace-json <path>        also write the phase timings as a Chrome trace (implies --trace)" << endl;
+    out << "  --bloom <rate>             reject absent words with a Bloom filter (e.g. 0.01)" << endl;
+    out << "  --freeze                   build the read-only dictionaries (MPH, FC and EYT; backends mph and fc)" << endl;
+    out << "  --serve <port>             serve queries on 127.0.0.1:<port> (HASH unless --backend names another)" << endl;
+    out << "  --serve-unix <path>        serve queries on a Unix-domain socket" << endl;
+    out << "  --workers <threads>        server worker threads (default: one per core)" << endl;
+}
+
+// Function to parse the command line, false if it is malformed
+inline bool parseOptions(int argc, char * argv[], SearchOptions & options) {
+
+    for (int i = 1; i < argc; i++) {
+
+        string option = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (option == "--files") {
+            while (i + 1 < argc && string(argv[i + 1]).compare(0, 2, "--") != 0)
+                options.files.push_back(argv[++i]);
+            if (options.files.empty())
+                return false;
+        }
+        else if (option == "--queries" && hasValue)
+            options.queryLog = argv[++i];
+        else if (option == "--backend" && hasValue)
+            options.backend = argv[++i];
+        else if (option == "--concurrency" && hasValue)
+            options.concurrency = stoi(argv[++i]);
+        else if (option == "--cache")
+            options.useCache = true;
+        else if (option == "--batch-bench" && hasValue)
+            options.batchLog = argv[++i];
+        else if (option == "--parallel-bench" && hasValue)
+            options.parallelLog = argv[++i];
+        else if (option == "--query-threads" && hasValue)
+            options.queryThreads = stoi(argv[++i]);
+        else if (option == "--shard-bench" && hasValue)
+            options.shardLog = argv[++i];
+        else if (option == "--shards" && hasValue) {
+            options.shardCounts.clear();
+            stringstream list(argv[++i]);
+            for (string count; getline(list, count, ','); )
+                options.shardCounts.push_back(stoi(count));
+        }
+        else if (option == "--shard-mode" && hasValue) {
+            string mode = argv[++i];
+            if (mode != "threads" && mode != "processes")
+                return false;
+            options.shardProcesses = mode == "processes";
+        }
+        else if (option == "--shard-prefix" && hasValue)
+            options.shardPrefix = argv[++i];
+        else if (option == "--view-bench" && hasValue)
+            options.viewLog = argv[++i];
+        else if (option == "--cache-bench" && hasValue)
+            options.cacheLog = argv[++i];
+        else if (option == "--cache-budget" && hasValue)
+            options.cacheBudget = stoul(argv[++i]);
+        else if (option == "--lookup-bench")
+            options.lookupBench = true;
+        else if (option == "--no-aggregate")
+            options.aggregate = false;
+        else if (option == "--pipeline" && hasValue)
+            options.pipelineReaders = stoi(argv[++i]);
+        else if (option == "--spill-budget" && hasValue)
+            options.spillBudget = stoul(argv[++i]);
+        else if (option == "--spill-prefix" && hasValue)
+            options.spillPrefix = argv[++i];
+        else if (option == "--spill-bench" && hasValue) {
+            stringstream list(argv[++i]);
+            for (string budget; getline(list, budget, ','); )
+                options.spillBench.push_back(stoul(budget));
+        }
+        else if (option == "--alloc-budget" && hasValue)
+            options.allocationBudget = stod(argv[++i]);
+        else if (option == "--intern-report" && hasValue)
+            options.internReport = stoul(argv[++i]);
+        else if (option == "--bulk-bench" && hasValue)
+            options.bulkBench = stoul(argv[++i]);
+        else if (option == "--rank-bench" && hasValue)
+            options.rankBench = stoul(argv[++i]);
+        else if (option == "--swiss-bench" && hasValue)
+            options.swissBench = stoul(argv[++i]);
+        else if (option == "--layout-bench" && hasValue) {
+            stringstream list(argv[++i]);
+            for (string count; getline(list, count, ','); )
+                options.layoutBench.push_back(stoul(count));
+        }
+        else if (option == "--trace")
+            options.trace = true;
+        else if (option == "--trace-json" && hasValue) {
+            options.trace = true;
+            options.traceJson = argv[++i];
+        }
+        else if (option == "--bloom" && hasValue)
+            options.bloomRate = stod(argv[++i]);
+        else if (option == "--freeze")
+            options.freeze = true;
+        else if (option == "--serve" && hasValue)
+            options.servePort = stoi(argv[++i]);
+        else if (option == "--serve-unix" && hasValue)
+            options.serveUnix = argv[++i];
+        else if (option == "--workers" && hasValue)
+            options.workers = stoi(argv[++i]);
+        else
+            return false;
+    }
+    for (int count : options.shardCounts)
+        if (count < 1)
+            return false;
+    return options.concurrency >= 1 && options.workers >= 1 && options.queryThreads >= 1 && options.pipelineReaders >= 0 && options.bloomRate >= 0 && options.bloomRate < 1;
+}
+
+#endif /* Options_h */
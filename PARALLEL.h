@@ -0,0 +1,184 @@
+#ifndef Parallel_h
+#define Parallel_h
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <iostream>
+#include <chrono>
+#include <algorithm>
+#include "QUERY.h"
+#include "STATS.h"
+#include "THREADPOOL.h"
+
+using namespace std;
+
+// Intra-query parallelism: one query's word lookups and its posting list
+// intersection are spread over a thread pool. Queries under the cutoffs
+// below stay on the calling thread, where waking the pool would cost more
+// than the work it takes over.
+static const size_t PARALLEL_MIN_TERMS = 5; // words before lookups fan out
+static const size_t PARALLEL_MIN_PROBES = 1 << 14; // shortest list length times the other lists, before the intersection is split
+
+// Struct to count which queries took the parallel paths
+struct ParallelStats {
+
+    size_t queries = 0;
+    size_t parallelLookups = 0; // Queries whose words were looked up concurrently
+    size_t parallelIntersections = 0; // Queries whose intersection was split by document range
+};
+
+// Function to run task(0) ... task(parts - 1) on the pool and the calling
+// thread, returning when all are done. Parts are claimed from a shared
+// counter, so the caller runs every part no worker has picked up yet and
+// never waits for one that has not started; a worker that arrives late finds
+// nothing left and leaves without touching task.
+template <class Task>
+void parallelFor(ThreadPool & pool, int parts, Task & task) {
+
+    struct Progress {
+        atomic<int> next{0};
+        int done = 0;
+        mutex lock;
+        condition_variable finished;
+    };
+    shared_ptr<Progress> progress = make_shared<Progress>();
+    auto work = [progress, parts, &task]() {
+        for (int part; (part = progress->next.fetch_add(1)) < parts; ) {
+            task(part);
+            lock_guard<mutex> guard(progress->lock);
+            if (++progress->done == parts)
+                progress->finished.notify_all();
+        }
+    };
+
+    for (int i = 1; i < parts; i++)
+        pool.submit(work);
+    work();
+    unique_lock<mutex> guard(progress->lock);
+    progress->finished.wait(guard, [&] { return progress->done == parts; });
+}
+
+// Function to evaluate one parsed query with up to pool.size() parts running
+// at once. The words are looked up in interleaved groups, one per part. The
+// intersection cuts the shortest list into equal runs of positions; each run
+// covers a range of document ids, the other lists are narrowed to that range
+// with two binary searches, and the runs are intersected independently. The
+// matches of the runs are joined in order, so the result equals evaluateQuery's.
+// lookup must be safe to call from several threads at once.
+template <class Lookup>
+QueryResult evaluateParallel(const vector<string> & words, Lookup lookup, ThreadPool & pool, ParallelStats * stats = nullptr) {
+
+    QueryResult result;
+    result.words = words;
+    int parts = pool.size();
+    if (stats != nullptr)
+        stats->queries++;
+
+    vector<const WordItem *> postings(words.size(), nullptr);
+    if (parts > 1 && words.size() >= PARALLEL_MIN_TERMS) {
+        int groups = min<int>(parts, (int) words.size());
+        auto lookupGroup = [&](int group) {
+            for (size_t i = group; i < words.size(); i += groups)
+                postings[i] = lookup(words[i]);
+        };
+        parallelFor(pool, groups, lookupGroup);
+        if (stats != nullptr)
+            stats->parallelLookups++;
+    }
+    else {
+        for (size_t i = 0; i < words.size(); i++)
+            postings[i] = lookup(words[i]);
+    }
+
+    vector<PostingList> lists;
+    int shortest = 0;
+    for (const WordItem * item : postings) {
+        if (item == nullptr)
+            return result; // A missing word means no document contains the whole query
+        lists.push_back(item->documents);
+        if (lists.back().size() < lists[shortest].size())
+            shortest = int(lists.size()) - 1;
+    }
+    if (lists.empty())
+        return result;
+
+    const PostingList walked = lists[shortest];
+    if (parts < 2 || walked.size() < (size_t) parts || walked.size() * (lists.size() - 1) < PARALLEL_MIN_PROBES) {
+        intersectLists(lists, result.matches);
+        return result;
+    }
+
+    vector<vector<QueryMatch>> found(parts);
+    auto intersectRun = [&](int part) {
+        size_t begin = walked.size() * part / parts, end = walked.size() * (part + 1) / parts;
+        PostingList positions = walked;
+        positions.offset += uint32_t(begin);
+        positions.length = uint32_t(end - begin);
+        uint32_t first = positions.docId(0), last = positions.docId(positions.size() - 1);
+        vector<PostingList> run(lists.size());
+        for (int i = 0; i < lists.size(); i++)
+            run[i] = i == shortest ? positions : lists[i].range(first, last);
+        intersectLists(run, found[part]);
+    };
+    parallelFor(pool, parts, intersectRun);
+    for (vector<QueryMatch> & matches : found)
+        for (QueryMatch & match : matches)
+            result.matches.push_back(std::move(match));
+    if (stats != nullptr)
+        stats->parallelIntersections++;
+    return result;
+}
+
+// Function to compare the latency of evaluateQuery with evaluateParallel on
+// every query of a log, grouped by the number of words in the query
+template <class Lookup>
+void benchmarkParallel(ostream & out, const string & name, const vector<string> & log, int threads, Lookup lookup) {
+
+    static const size_t BUCKETS[][2] = { { 1, 4 }, { 5, 9 }, { 10, 14 }, { 15, 20 }, { 21, 1000 } };
+    ThreadPool pool(threads);
+    vector<vector<string>> queries;
+    for (const string & line : log)
+        queries.push_back(parseQuery(line));
+
+    for (const auto & bucket : BUCKETS) {
+
+        vector<long long> serialNanos, parallelNanos;
+        ParallelStats stats;
+        size_t mismatches = 0;
+        for (const vector<string> & words : queries) {
+
+            if (words.size() < bucket[0] || words.size() > bucket[1])
+                continue;
+            auto start = chrono::high_resolution_clock::now();
+            QueryResult serial = evaluateQuery(words, lookup);
+            serialNanos.push_back(elapsedNanos(start));
+
+            start = chrono::high_resolution_clock::now();
+            QueryResult parallel = evaluateParallel(words, lookup, pool, &stats);
+            parallelNanos.push_back(elapsedNanos(start));
+            bool same = serial.matches.size() == parallel.matches.size();
+            for (size_t i = 0; same && i < serial.matches.size(); i++)
+                same = serial.matches[i].documentName == parallel.matches[i].documentName
+                       && serial.matches[i].counts == parallel.matches[i].counts;
+            mismatches += !same;
+        }
+        if (serialNanos.empty())
+            continue;
+
+        double serialMean = meanNanos(serialNanos), parallelMean = meanNanos(parallelNanos);
+        out << name << " " << bucket[0] << "-" << bucket[1] << " words, " << serialNanos.size() << " queries: serial mean "
+            << serialMean / 1000 << " us, p99 " << percentileNanos(serialNanos, 99) / 1000.0 << " us; "
+            << pool.size() << " threads mean " << parallelMean / 1000 << " us, p99 " << percentileNanos(parallelNanos, 99) / 1000.0
+            << " us; speedup " << serialMean / parallelMean << " (" << stats.parallelLookups << " parallel lookups, "
+            << stats.parallelIntersections << " split intersections";
+        if (mismatches > 0)
+            out << ", " << mismatches << " RESULTS DIFFER";
+        out << ")" << endl;
+    }
+}
+
+#endif /* Parallel_h */
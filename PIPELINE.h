@@ -0,0 +1,475 @@
+#ifndef Pipeline_h
+#define Pipeline_h
+
+#include <string>
+#include <vector>
+#include <tuple>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <chrono>
+#include "BACKEND.h"
+#include "INDEX.h"
+#include "STATS.h"
+#include "POOL.h"
+#include "POSTINGS.h"
+#include "BLOOM.h"
+#include "AGGREGATE.h"
+#include "TRACE.h"
+#include "QUERY.h"
+#include "CACHE.h"
+
+using namespace std;
+
+// The ingestion and query pipeline, written once and instantiated for every
+// dictionary backend. All calls into the backend are resolved at compile time.
+// New words are interned in a term pool, shared by default with every other
+// index, and the backend keys on the pooled view. Postings go to the index's
+// posting store; finalize() compacts them and points every word item at its
+// slice, so it must run after the last document and before any query.
+// enableGuard() puts a Bloom filter of the vocabulary in front of lookup(),
+// so most absent words are turned away without touching the dictionary. The
+// filter is rebuilt with twice the room when it fills up and rebuilt to size
+// by finalize(), which also drops the words removed since the last build.
+// By default addDocument() first counts a document's words in a local table
+// and then adds every distinct word once with its count; setAggregation(false)
+// sends every token to the dictionary instead.
+// addSortedWord() adds a new word with all its postings; loaders of saved
+// indexes call it with the words in increasing order, and a backend with
+// bulkLoad() then builds its dictionary from them in one pass.
+// attachCache() hands the index a query cache to keep current: every
+// mutation (addWord(), remove(), finalize()) goes through mutated(), which
+// drops the cached results that could have changed.
+template <class Backend>
+class SearchIndex
+{
+    static_assert( BackendInterface<Backend>::value, "not a dictionary backend" );
+
+  public:
+
+    SearchIndex( TermPool & terms = sharedTermPool( ) ) : pool( &terms ) { }
+
+    static const char * name( ) { return Backend::name( ); }
+
+    void addDocument( const string & file_name );
+    void addDocument( const string & file_name, uint32_t document ); // with an id interned by the caller
+    void addWord( string_view word, uint32_t document, uint32_t count = 1 );
+    void addSortedWord( string_view word, const vector<pair<uint32_t, uint32_t>> & postings ); // (document, count) in document order
+    void finalize( );
+    void enableGuard( double falsePositiveRate );
+    void setAggregation( bool on ) { aggregating = on; }
+    bool aggregates( ) const { return aggregating; }
+    const WordItem * lookup( string_view word ) const
+    {
+        if ( guarded && !filter.mayContain( word ) )
+            return nullptr;
+        return dictionary.find( word );
+    }
+    void remove( string_view word )
+    {
+        flushSortedWords( );
+        dictionary.remove( word );
+        mutated( word );
+    }
+    void attachCache( QueryCache * results ) { cache = results; } // nullptr detaches
+
+    Backend & backend( ) { return dictionary; }
+    const Backend & backend( ) const { return dictionary; }
+    long long ingestionTime( ) const { return ingestionNanos; }
+    void addIngestionTime( long long nanos ) { ingestionNanos += nanos; } // for words added through addWord() directly
+    long long tokenCount( ) const { return tokens; }
+    long long dictionaryOperations( ) const { return operations; } // finds and inserts made while adding words
+    const TermPool & terms( ) const { return *pool; }
+    const PostingStore & postings( ) const { return postingStore; }
+    bool hasGuard( ) const { return guarded; }
+    const BloomFilter & guard( ) const { return filter; }
+
+  private:
+
+    Backend dictionary;
+    TermPool * pool;
+    PostingStore postingStore;
+    BloomFilter filter;
+    bool guarded = false;
+    double guardRate = 0;
+    long long ingestionNanos = 0;
+    long long tokens = 0; // Words added so far
+    long long operations = 0;
+    bool aggregating = true;
+    DocumentTerms documentTerms; // Words of the document being read, reused
+    QueryCache * cache = nullptr; // Results to invalidate on mutation, if any
+    vector<pair<string_view, WordItem>> sortedWords; // Added by addSortedWord() and not yet in the dictionary
+
+    void rebuildGuard( size_t capacity );
+    void flushSortedWords( );
+    void mutated( string_view word )
+    {
+        if ( cache != nullptr )
+            cache->invalidate( string( word ) );
+    }
+};
+
+/**
+ * Read a document and add every word in it to the dictionary.
+ */
+template <class Backend>
+void SearchIndex<Backend>::addDocument( const string & file_name )
+{
+    addDocument( file_name, sharedDocumentNames( ).intern( file_name ) );
+}
+
+/**
+ * Read a document whose name the caller has interned already. Indexes
+ * built on several threads use this, since interning is not thread safe.
+ */
+template <class Backend>
+void SearchIndex<Backend>::addDocument( const string & file_name, uint32_t document )
+{
+    auto start = chrono::high_resolution_clock::now( );
+    ifstream file( file_name );
+    string word;
+    vector<string> separated_word; // Reused, so a token costs no allocation once it has grown
+    // Read each word from file
+    while ( file >> word )
+    {
+        toLowercase( word ); // Convert word to lowercase
+        separated_word.clear( );
+        removePunctuationAndDigits( word, separated_word ); // Remove punctuation and digits from word
+        for ( const string & separated : separated_word )
+        {
+            if ( separated == "" )
+                continue;
+            if ( aggregating )
+                documentTerms.add( separated );
+            else
+                addWord( separated, document );
+        }
+    }
+    documentTerms.forEach( [&]( string_view term, uint32_t count ) { addWord( term, document, count ); } );
+    documentTerms.clear( );
+    ingestionNanos += elapsedNanos( start );
+}
+
+/**
+ * Count occurrences of word in the given document.
+ */
+template <class Backend>
+void SearchIndex<Backend>::addWord( string_view word, uint32_t document, uint32_t count )
+{
+    flushSortedWords( );
+    tokens += count;
+    operations++;
+    mutated( word );
+    WordItem * item = dictionary.find( word );
+
+    // if word is not in the dictionary, insert it first
+    if ( item == nullptr )
+    {
+        uint32_t termId = pool->intern( word );
+        string_view term = pool->term( termId );
+        WordItem n_word;
+        n_word.word_name = term;
+        n_word.termId = termId;
+        dictionary.insert( term, std::move( n_word ) );
+        operations++;
+        postingStore.add( termId, document, count );
+        if ( guarded )
+        {
+            if ( filter.full( ) )
+                rebuildGuard( 2 * filter.capacity( ) ); // the new word is already in the dictionary
+            else
+                filter.add( term );
+        }
+        return;
+    }
+    postingStore.add( item->termId, document, count );
+}
+
+/**
+ * Add a word that is not in the index yet, with its postings. Words added
+ * this way in increasing order to an empty index are kept aside and, for a
+ * backend with bulkLoad(), become the dictionary in one pass at the next
+ * finalize(), addWord() or remove(). Anything else falls back to addWord().
+ */
+template <class Backend>
+void SearchIndex<Backend>::addSortedWord( string_view word, const vector<pair<uint32_t, uint32_t>> & postings )
+{
+    bool deferred = BackendBulkLoads<Backend>::value && dictionary.size( ) == 0 && !postings.empty( )
+                    && ( sortedWords.empty( ) || sortedWords.back( ).first < word );
+    if ( !deferred )
+    {
+        for ( const pair<uint32_t, uint32_t> & posting : postings )
+            addWord( word, posting.first, posting.second );
+        return;
+    }
+
+    operations++;
+    mutated( word );
+    uint32_t termId = pool->intern( word );
+    WordItem item;
+    item.word_name = pool->term( termId );
+    item.termId = termId;
+    sortedWords.emplace_back( item.word_name, std::move( item ) );
+    for ( const pair<uint32_t, uint32_t> & posting : postings )
+    {
+        tokens += posting.second;
+        operations++;
+        postingStore.add( termId, posting.first, posting.second );
+    }
+}
+
+// Move the words kept aside by addSortedWord() into the dictionary
+template <class Backend>
+void SearchIndex<Backend>::flushSortedWords( )
+{
+    if ( sortedWords.empty( ) )
+        return;
+    if constexpr ( BackendBulkLoads<Backend>::value )
+        dictionary.bulkLoad( sortedWords );
+    vector<pair<string_view, WordItem>>( ).swap( sortedWords );
+    if ( guarded )
+        rebuildGuard( 2 * dictionary.size( ) );
+}
+
+/**
+ * Compact the postings and give every word item its slice.
+ */
+template <class Backend>
+void SearchIndex<Backend>::finalize( )
+{
+    auto start = chrono::high_resolution_clock::now( );
+    flushSortedWords( );
+    postingStore.finalize( );
+    vector<string_view> words;
+    dictionary.forEach( [&]( string_view word, const WordItem & ) { words.push_back( word ); } );
+    for ( string_view word : words )
+    {
+        WordItem * item = dictionary.find( word );
+        item->documents = postingStore.list( item->termId );
+    }
+    if constexpr ( BackendFinalizes<Backend>::value )
+        dictionary.finalize( );
+    if ( guarded )
+        rebuildGuard( words.size( ) );
+    if ( cache != nullptr )
+        cache->clear( ); // every word's postings were rebuilt
+    ingestionNanos += elapsedNanos( start );
+}
+
+/**
+ * Consult a Bloom filter with the given false positive rate before every
+ * lookup. Call it before ingestion or after it; either way the filter
+ * starts out holding the current vocabulary.
+ */
+template <class Backend>
+void SearchIndex<Backend>::enableGuard( double falsePositiveRate )
+{
+    guarded = true;
+    guardRate = falsePositiveRate;
+    rebuildGuard( dictionary.size( ) );
+}
+
+// Refill the filter from the dictionary, with room for capacity words
+template <class Backend>
+void SearchIndex<Backend>::rebuildGuard( size_t capacity )
+{
+    filter.reset( capacity, guardRate );
+    dictionary.forEach( [&]( string_view word, const WordItem & ) { filter.add( word ); } );
+}
+
+/**
+ * A search index with a term pool of its own instead of the shared one, for
+ * indexes that are built, saved and dropped on their own (shards, spill runs).
+ */
+template <class Backend>
+struct StandaloneIndex
+{
+    TermPool terms; // Declared first: the index keeps a pointer to it
+    SearchIndex<Backend> index;
+
+    StandaloneIndex( ) : index( terms ) { }
+};
+
+// Function to call f on every index in a tuple of SearchIndex objects, in order
+template <class Indexes, class Function>
+void forEachIndex(Indexes & indexes, Function f) {
+    apply([&](auto & ... index) { (f(index), ...); }, indexes);
+}
+
+// Function to check if a word is in the vector and add it to a temporary vector
+inline void isWordInVector(const vector<WordOutput>& vec, vector<WordOutput>& temp, const string& filename) {
+
+    for (const auto& element : vec) {
+        if (element.documentName == filename)
+            temp.push_back(element); // Word found in vector
+    }
+}
+
+// Function to check if a word is found in the vector
+inline bool isFoundWordInVector(const vector<WordOutput>& vec, const string& filename, const string& word) {
+
+    for (const auto& element : vec) {
+        if (element.documentName == filename && element.word == word)
+            return true;
+    }
+    return false;
+}
+
+// Function to answer one query the way the interactive loop did before query
+// views: copy every posting of every word into a WordOutput, then scan those
+// for each input file. Kept as the baseline of benchmarkViews.
+template <class Lookup>
+void materializedQuery(ostream & out, const vector<string> & words, const vector<string> & files_name, Lookup lookup) {
+
+    vector<WordOutput> word_details, found_word;
+    for (int a = 0; a < words.size(); a++){
+
+        const WordItem * word_information = lookup(words[a]);
+        if (word_information != nullptr){
+
+            for (int c = 0; c < word_information->documents.size(); c++){
+
+                WordOutput temp;
+                temp.documentName = string(documentName(word_information->documents.docId(c)));
+                temp.count = word_information->documents.count(c);
+                temp.word = words[a];
+                word_details.push_back(temp);
+            }
+        }
+    }
+
+    // Check if all words in query exist in any document
+    bool check = false;
+    for (int a = 0; a < files_name.size(); a++){
+
+        int num = 0;
+        for (int b = 0; b < words.size(); b++){
+            if (isFoundWordInVector(word_details, files_name[a], words[b]))
+                num++;
+        }
+        if (num == words.size())
+            check = true;
+    }
+
+    if (!check) {
+        out << "No document contains the given query" << endl;
+        return;
+    }
+    for (int i = 0; i < files_name.size(); i++){
+
+        found_word.clear();
+        isWordInVector(word_details, found_word, files_name[i]);
+        if (found_word.size() != words.size())
+            continue;
+        out << "in Document " << files_name[i] << ", ";
+        for (int j = 0; j < words.size(); j++){
+
+            for (int f = 0; f < found_word.size(); f++){
+
+                if (j != found_word.size() - 1 && words[j] == found_word[f].word)
+                    out << words[j] << " found " << found_word[f].count << " times, ";
+                else if (j == found_word.size() - 1 && words[j] == found_word[f].word)
+                    out << words[j] << " found " << found_word[f].count << " times." << endl;
+            }
+        }
+    }
+}
+
+// Function to answer one interactive query against one index and print the result.
+// The query is answered k times; returns the time that took in nanoseconds.
+// Every answer is a QueryView over the posting store: the lookups, then the
+// walk over the documents holding every word. Strings are only made while
+// printing. With a tracer, every repetition's lookups and walk and the output
+// are timed into the tracer's histograms of track.
+template <class Index>
+long long interactiveQuery(Index & index, const vector<string> & words, int k, PhaseTracer * tracer = nullptr, int track = 0) {
+
+    auto start = chrono::high_resolution_clock::now();
+    if (!words.empty() && words[0] == "remove"){ // Check if the command is to remove a word
+
+        if (words.size() > 1) {
+            index.remove(words[1]);
+            cout << words[1] << " has been REMOVED" << endl;
+        }
+        return elapsedNanos(start);
+    }
+
+    auto phaseStart = start;
+    auto endPhase = [&](QueryPhase phase) {
+        if (tracer == nullptr)
+            return;
+        auto now = chrono::high_resolution_clock::now();
+        tracer->record(track, phase, phaseStart, now);
+        phaseStart = now;
+    };
+    auto lookup = [&](const string & word) { return index.lookup(word); };
+
+    QueryView view(words, lookup);
+    size_t matches = 0;
+    for (int i = 0; i < k; i++){
+        if (tracer != nullptr)
+            phaseStart = chrono::high_resolution_clock::now();
+        view = QueryView(words, lookup);
+        endPhase(PhaseLookup);
+        matches = 0;
+        while (view.next())
+            matches++;
+        endPhase(PhaseMerge);
+    }
+    long long time = elapsedNanos(start);
+
+    // The result lines are formatted apart from the write, so the two are timed separately
+    if (tracer != nullptr)
+        phaseStart = chrono::high_resolution_clock::now();
+    ostringstream lines;
+    printQueryView(lines, view, words);
+    endPhase(PhaseAssemble);
+    cout << lines.str() << flush;
+    endPhase(PhaseOutput);
+    return time;
+}
+
+// Stream buffer that drops everything, so output formatting can be timed without a terminal
+struct DiscardBuffer : streambuf {
+    int overflow(int c) override { return c; }
+};
+
+// Function to time every query of the log, formatted into a discarding
+// stream, the materialized way and through a query view. Reports latency
+// and, when countAllocations() does not return -1, allocations per query.
+template <class Lookup, class Counter>
+void benchmarkViews(ostream & out, const string & name, const vector<string> & queries, const vector<string> & files_name,
+                    Lookup lookup, Counter countAllocations) {
+
+    DiscardBuffer discard;
+    ostream sink(&discard);
+    vector<vector<string>> parsed;
+    for (const string & query : queries)
+        parsed.push_back(parseQuery(query));
+    for (const vector<string> & words : parsed) { // warm up
+        QueryView view(words, lookup);
+        printQueryView(sink, view, words);
+    }
+
+    for (int pass = 0; pass < 2; pass++) {
+        vector<long long> samples;
+        long long allocations = countAllocations();
+        for (const vector<string> & words : parsed) {
+            auto start = chrono::high_resolution_clock::now();
+            if (pass == 0)
+                materializedQuery(sink, words, files_name, lookup);
+            else {
+                QueryView view(words, lookup);
+                printQueryView(sink, view, words);
+            }
+            samples.push_back(elapsedNanos(start));
+        }
+        out << name << (pass == 0 ? " materialized: " : " query view: ") << meanNanos(samples) / 1000.0 << " us mean, p50 "
+            << percentileNanos(samples, 50) / 1000.0 << " us, p99 " << percentileNanos(samples, 99) / 1000.0 << " us";
+        if (allocations >= 0 && !parsed.empty())
+            out << ", " << (double) (countAllocations() - allocations) / parsed.size() << " allocations per query";
+        out << endl;
+    }
+}
+
+#endif /* Pipeline_h */
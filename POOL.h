@@ -0,0 +1,185 @@
+#ifndef Pool_h
+#define Pool_h
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include "MEMORY.h"
+
+using namespace std;
+
+// Append-only pool of unique terms. Every term is copied once into large
+// chunks that never move, so the string_view handed out for it stays valid
+// for the life of the pool; the dictionaries key on these views instead of
+// owning a copy of the word. Every term also gets a dense id (0, 1, 2, ...)
+// in order of first appearance. Terms are never removed: a word removed
+// from a dictionary keeps its bytes and id, and gets both back if it is
+// added again. intern() is not thread safe; term() and find() may run
+// concurrently once ingestion is over.
+class TermPool
+{
+  public:
+
+    TermPool( ) : chunkUsed( 0 ), bytes( 0 ) { }
+
+    uint32_t intern( string_view term ); // id of term, adding it if needed
+    int find( string_view term ) const; // id of term, -1 if it was never interned
+    string_view term( uint32_t id ) const { return terms[ id ]; }
+    size_t size( ) const { return terms.size( ); }
+    size_t termBytes( ) const { return bytes; } // bytes of all terms, without chunk slack
+    MemoryReport memoryUsage( ) const;
+
+  private:
+
+    static const size_t CHUNK_BYTES = 1 << 16;
+
+    vector<unique_ptr<char[]>> chunks; // Term bytes, terms never span chunks
+    vector<size_t> chunkSizes;
+    size_t chunkUsed; // Bytes used in the last chunk
+    vector<string_view> terms; // Term of every id
+    vector<uint32_t> slots; // Open addressing table of id + 1, 0 is empty
+    size_t bytes;
+
+    size_t findSlot( string_view term ) const;
+    const char * store( string_view term );
+    void grow( );
+};
+
+// FNV-1a over the bytes of a term, with the high bits folded into the low
+// ones that pick the slot. The term pool and DocumentTerms both use it.
+inline uint64_t termHash( string_view term )
+{
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for ( unsigned char c : term )
+    {
+        h ^= c;
+        h *= 0x100000001b3ULL;
+    }
+    return h ^ ( h >> 29 );
+}
+
+/**
+ * Linear probing: return the slot holding term, or the empty slot
+ * where the search for it ends.
+ */
+inline size_t TermPool::findSlot( string_view term ) const
+{
+    size_t mask = slots.size( ) - 1;
+    size_t pos = termHash( term ) & mask;
+    while ( slots[ pos ] != 0 && terms[ slots[ pos ] - 1 ] != term )
+        pos = ( pos + 1 ) & mask;
+    return pos;
+}
+
+// Copy the bytes of term into the current chunk, starting a new one when full
+inline const char * TermPool::store( string_view term )
+{
+    if ( chunks.empty( ) || chunkUsed + term.size( ) > chunkSizes.back( ) )
+    {
+        size_t size = term.size( ) > CHUNK_BYTES ? term.size( ) : CHUNK_BYTES;
+        chunks.emplace_back( new char[ size ] );
+        chunkSizes.push_back( size );
+        chunkUsed = 0;
+    }
+    char * destination = chunks.back( ).get( ) + chunkUsed;
+    if ( !term.empty( ) )
+        memcpy( destination, term.data( ), term.size( ) );
+    chunkUsed += term.size( );
+    bytes += term.size( );
+    return destination;
+}
+
+// Double the table and reinsert every id
+inline void TermPool::grow( )
+{
+    slots.assign( slots.empty( ) ? 1024 : slots.size( ) * 2, 0 );
+    for ( uint32_t id = 0; id < terms.size( ); id++ )
+        slots[ findSlot( terms[ id ] ) ] = id + 1;
+}
+
+inline uint32_t TermPool::intern( string_view term )
+{
+    if ( ( terms.size( ) + 1 ) * 10 > slots.size( ) * 7 )    // keep the load under 0.7
+        grow( );
+    size_t pos = findSlot( term );
+    if ( slots[ pos ] != 0 )
+        return slots[ pos ] - 1;
+
+    uint32_t id = uint32_t( terms.size( ) );
+    terms.push_back( string_view( store( term ), term.size( ) ) );
+    slots[ pos ] = id + 1;
+    return id;
+}
+
+inline int TermPool::find( string_view term ) const
+{
+    if ( slots.empty( ) )
+        return -1;
+    size_t pos = findSlot( term );
+    return slots[ pos ] == 0 ? -1 : int( slots[ pos ] - 1 );
+}
+
+inline MemoryReport TermPool::memoryUsage( ) const
+{
+    MemoryReport report;
+    for ( size_t size : chunkSizes )
+        addAllocation( report, size );
+    report.keyBytes += bytes;
+    for ( size_t size : chunkSizes )
+        report.slackBytes += size;
+    report.slackBytes -= bytes;    // unused tails of the chunks
+    accountVector( terms, report.nodeBytes, report );
+    accountVector( slots, report.nodeBytes, report );
+    accountVector( chunks, report.nodeBytes, report );
+    accountVector( chunkSizes, report.nodeBytes, report );
+    return report;
+}
+
+// The pool shared by every dictionary of the program
+inline TermPool & sharedTermPool( )
+{
+    static TermPool pool;
+    return pool;
+}
+
+// Function to compare the memory of count unique terms held as copies by
+// four string fields (the BST key and word_name, the hash key and
+// word_name) with one pooled copy and four string_views.
+inline void reportInterning(ostream & out, size_t count) {
+
+    TermPool pool;
+    MemoryReport copies;
+    mt19937 random(11);
+    string term;
+    while (pool.size() < count) {
+        term.clear();
+        int length = 3 + random() % 18; // 3 to 20 letters, so some terms outgrow the small string buffer
+        for (int i = 0; i < length; i++)
+            term += char('a' + random() % 26);
+        if (pool.find(term) >= 0)
+            continue;
+        pool.intern(term);
+        string copy = term;
+        copy.shrink_to_fit();
+        for (int field = 0; field < 4; field++) {
+            copies.keyBytes += sizeof(string) + heapBytes(copy);
+            addAllocation(copies, heapBytes(copy));
+        }
+    }
+
+    MemoryReport pooled = pool.memoryUsage();
+    pooled.nodeBytes += 4 * sizeof(string_view) * count;
+    const double MB = 1024.0 * 1024.0;
+    out << count << " terms held by four string fields: " << copies.total() / MB << " MB in "
+        << copies.allocations << " allocations" << endl;
+    out << count << " terms in the pool with four views: " << pooled.total() / MB << " MB in "
+        << pooled.allocations << " allocations" << endl;
+    out << "Saved: " << ((double) copies.total() - (double) pooled.total()) / MB << " MB" << endl;
+}
+
+#endif /* Pool_h */
@@ -0,0 +1,258 @@
+#ifndef Postings_h
+#define Postings_h
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <utility>
+#include "MEMORY.h"
+#include "POOL.h"
+
+using namespace std;
+
+class PostingStore;
+
+// The postings of one word: a slice of the store's columns, addressed by
+// offset and length. Entries are sorted by document id.
+struct PostingList {
+
+    const PostingStore * store = nullptr;
+    uint32_t offset = 0;
+    uint32_t length = 0;
+
+    size_t size() const { return length; }
+    bool empty() const { return length == 0; }
+    uint32_t docId(size_t i) const;
+    uint32_t count(size_t i) const;
+    int find(uint32_t document) const; // position of document, -1 if absent
+    PostingList range(uint32_t first, uint32_t last) const; // the entries with first <= document <= last
+};
+
+// Postings of every word in struct-of-arrays form: one column of document
+// ids and one of counts, with each word's entries stored contiguously.
+// During ingestion add() appends to a per-word chain (a linked list threaded
+// through three flat arrays, so no word owns a heap block); finalize()
+// copies the chains into the columns word by word and frees them. Words are
+// addressed by their term pool id. Documents normally arrive in increasing
+// id order, which keeps every list sorted; a document added again later (a
+// file listed twice) is merged into its earlier entry by finalize().
+class PostingStore
+{
+  public:
+
+    static constexpr uint32_t NONE = UINT32_MAX;
+
+    void add( uint32_t termId, uint32_t document, uint32_t count = 1 ); // count occurrences
+    void finalize( ); // compact the chains into the columns
+    PostingList list( uint32_t termId ) const;
+    size_t postings( ) const { return documentColumn.size( ); }
+    size_t terms( ) const { return offsets.empty( ) ? 0 : offsets.size( ) - 1; }
+    bool finalized( ) const { return chainDocument.empty( ); }
+    MemoryReport memoryUsage( ) const;
+
+  private:
+
+    friend struct PostingList;
+
+    vector<uint32_t> documentColumn; // Finalized document ids
+    vector<uint32_t> countColumn; // Finalized counts
+    vector<uint32_t> offsets; // Word t owns entries [offsets[t], offsets[t + 1])
+
+    vector<uint32_t> chainDocument; // Postings added since the last finalize
+    vector<uint32_t> chainCount;
+    vector<uint32_t> chainNext; // Next entry of the same word, NONE at the end
+    vector<uint32_t> chainHead; // First and last chain entry of every word
+    vector<uint32_t> chainTail;
+
+    static void sortEntries( vector<uint32_t> & documents, vector<uint32_t> & counts, size_t begin );
+};
+
+inline uint32_t PostingList::docId( size_t i ) const
+{
+    return store->documentColumn[ offset + i ];
+}
+
+inline uint32_t PostingList::count( size_t i ) const
+{
+    return store->countColumn[ offset + i ];
+}
+
+// Binary search, the list is sorted by document id
+inline int PostingList::find( uint32_t document ) const
+{
+    if ( length == 0 )
+        return -1;
+    const uint32_t * first = &store->documentColumn[ offset ];
+    const uint32_t * match = lower_bound( first, first + length, document );
+    return match != first + length && *match == document ? int( match - first ) : -1;
+}
+
+// The sub-slice of documents in [first, last], found by two binary searches
+inline PostingList PostingList::range( uint32_t first, uint32_t last ) const
+{
+    PostingList slice = *this;
+    if ( length == 0 )
+        return slice;
+    const uint32_t * begin = &store->documentColumn[ offset ];
+    const uint32_t * low = lower_bound( begin, begin + length, first );
+    const uint32_t * high = upper_bound( low, begin + length, last );
+    slice.offset = offset + uint32_t( low - begin );
+    slice.length = uint32_t( high - low );
+    return slice;
+}
+
+/**
+ * Count occurrences of a word in a document. A repeat of the word in the
+ * document being ingested only bumps the count at the tail of its chain.
+ */
+inline void PostingStore::add( uint32_t termId, uint32_t document, uint32_t count )
+{
+    if ( termId >= chainHead.size( ) )
+    {
+        chainHead.resize( termId + 1, NONE );
+        chainTail.resize( termId + 1, NONE );
+    }
+
+    uint32_t tail = chainTail[ termId ];
+    if ( tail != NONE && chainDocument[ tail ] == document )
+    {
+        chainCount[ tail ] += count;
+        return;
+    }
+
+    uint32_t entry = uint32_t( chainDocument.size( ) );
+    chainDocument.push_back( document );
+    chainCount.push_back( count );
+    chainNext.push_back( NONE );
+    if ( tail == NONE )
+        chainHead[ termId ] = entry;
+    else
+        chainNext[ tail ] = entry;
+    chainTail[ termId ] = entry;
+}
+
+/**
+ * Rebuild the columns: for every word, its finalized entries followed by its
+ * chain. Lists handed out before this call are stale afterwards.
+ */
+inline void PostingStore::finalize( )
+{
+    if ( chainDocument.empty( ) )
+        return;
+
+    size_t terms = max( chainHead.size( ), offsets.empty( ) ? 0 : offsets.size( ) - 1 );
+    vector<uint32_t> documents, counts, starts( terms + 1, 0 );
+    documents.reserve( documentColumn.size( ) + chainDocument.size( ) );
+    counts.reserve( documents.capacity( ) );
+
+    for ( size_t t = 0; t < terms; t++ )
+    {
+        starts[ t ] = uint32_t( documents.size( ) );
+        if ( t + 1 < offsets.size( ) )
+            for ( uint32_t i = offsets[ t ]; i < offsets[ t + 1 ]; i++ )
+            {
+                documents.push_back( documentColumn[ i ] );
+                counts.push_back( countColumn[ i ] );
+            }
+        bool ordered = true;
+        for ( uint32_t i = t < chainHead.size( ) ? chainHead[ t ] : NONE; i != NONE; i = chainNext[ i ] )
+        {
+            // The same document added again after an earlier finalize
+            if ( documents.size( ) > starts[ t ] && documents.back( ) == chainDocument[ i ] )
+                counts.back( ) += chainCount[ i ];
+            else
+            {
+                if ( documents.size( ) > starts[ t ] && documents.back( ) > chainDocument[ i ] )
+                    ordered = false;
+                documents.push_back( chainDocument[ i ] );
+                counts.push_back( chainCount[ i ] );
+            }
+        }
+        if ( !ordered )
+            sortEntries( documents, counts, starts[ t ] );
+    }
+    starts[ terms ] = uint32_t( documents.size( ) );
+
+    documentColumn.swap( documents );
+    countColumn.swap( counts );
+    offsets.swap( starts );
+    documentColumn.shrink_to_fit( );
+    countColumn.shrink_to_fit( );
+
+    vector<uint32_t>( ).swap( chainDocument );
+    vector<uint32_t>( ).swap( chainCount );
+    vector<uint32_t>( ).swap( chainNext );
+    vector<uint32_t>( ).swap( chainHead );
+    vector<uint32_t>( ).swap( chainTail );
+}
+
+/**
+ * Sort the entries from begin on by document id and merge the entries of
+ * the same document, summing their counts.
+ */
+inline void PostingStore::sortEntries( vector<uint32_t> & documents, vector<uint32_t> & counts, size_t begin )
+{
+    vector<pair<uint32_t, uint32_t>> entries;
+    for ( size_t i = begin; i < documents.size( ); i++ )
+        entries.emplace_back( documents[ i ], counts[ i ] );
+    sort( entries.begin( ), entries.end( ) );
+
+    size_t end = begin;
+    for ( const pair<uint32_t, uint32_t> & entry : entries )
+    {
+        if ( end > begin && documents[ end - 1 ] == entry.first )
+            counts[ end - 1 ] += entry.second;
+        else
+        {
+            documents[ end ] = entry.first;
+            counts[ end ] = entry.second;
+            end++;
+        }
+    }
+    documents.resize( end );
+    counts.resize( end );
+}
+
+// The finalized postings of a word, empty if it has none
+inline PostingList PostingStore::list( uint32_t termId ) const
+{
+    PostingList postingList;
+    postingList.store = this;
+    if ( termId + 1 < offsets.size( ) )
+    {
+        postingList.offset = offsets[ termId ];
+        postingList.length = offsets[ termId + 1 ] - offsets[ termId ];
+    }
+    return postingList;
+}
+
+inline MemoryReport PostingStore::memoryUsage( ) const
+{
+    MemoryReport report;
+    accountVector( documentColumn, report.postingBytes, report );
+    accountVector( countColumn, report.postingBytes, report );
+    accountVector( offsets, report.nodeBytes, report );
+    accountVector( chainDocument, report.postingBytes, report );
+    accountVector( chainCount, report.postingBytes, report );
+    accountVector( chainNext, report.postingBytes, report );
+    accountVector( chainHead, report.nodeBytes, report );
+    accountVector( chainTail, report.nodeBytes, report );
+    return report;
+}
+
+// The names of the ingested documents. A document's id is its id in this
+// pool, so every index numbers the same file the same way.
+inline TermPool & sharedDocumentNames( )
+{
+    static TermPool names;
+    return names;
+}
+
+// Function to get the name of a document id
+inline string_view documentName( uint32_t document ) {
+    return sharedDocumentNames( ).term( document );
+}
+
+#endif /* Postings_h */
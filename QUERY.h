@@ -0,0 +1,402 @@
+#ifndef Query_h
+#define Query_h
+
+#include <string>
+#include <vector>
+#include <sstream>
+#include <fstream>
+#include <iostream>
+#include <unordered_map>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include "INDEX.h"
+#include "STATS.h"
+
+using namespace std;
+
+// Struct to represent one document that contains every queried word
+struct QueryMatch {
+
+    uint32_t document = 0; // Id of the document
+    string documentName; // Name of the document
+    vector<int> counts; // Occurrences of each queried word, in query order
+};
+
+// Struct to represent the answer to one query
+struct QueryResult {
+
+    vector<string> words; // Normalized query words
+    vector<QueryMatch> matches; // Documents containing all words, in ingestion order
+};
+
+// Struct to count the work done by one batch
+struct BatchStats {
+
+    size_t queries = 0; // Queries in the batch
+    size_t words = 0; // Query words before deduplication
+    size_t lookups = 0; // Dictionary lookups actually performed
+};
+
+// Function to split a query line into lowercase words, the same way documents are tokenized
+inline vector<string> parseQuery(const string & line) {
+
+    vector<string> words;
+    istringstream iss(line);
+    string word;
+    while (iss >> word) {
+        toLowercase(word);
+        vector<string> separated_words;
+        removePunctuationAndDigits(word, separated_words);
+        for (const string & separated : separated_words) {
+            if (separated != "")
+                words.push_back(separated);
+        }
+    }
+    return words;
+}
+
+/**
+ * The answer to one query as a view of the posting store. next() steps
+ * through the documents that hold every word, in document id order, by
+ * walking the shortest posting list and binary searching the others. Nothing
+ * is copied: the name and the counts of the current document are read from
+ * the store when they are asked for, so strings are made only where the
+ * result is printed. The view is valid while the index is not changed.
+ */
+class QueryView
+{
+  public:
+
+    explicit QueryView( vector<PostingList> lists );
+    template <class Lookup>
+    QueryView( const vector<string> & words, Lookup lookup ); // lookup(word) returns a WordItem or nullptr
+
+    bool next( ); // move to the next matching document, false after the last
+    void rewind( ) { cursor = 0; }
+    uint32_t document( ) const { return lists[ shortest ].docId( cursor - 1 ); }
+    string_view name( ) const { return documentName( document( ) ); }
+    uint32_t count( size_t word ) const { return lists[ word ].count( positions[ word ] ); } // occurrences of the word-th queried word
+    size_t words( ) const { return lists.size( ); }
+
+  private:
+
+    vector<PostingList> lists; // One per queried word
+    vector<int> positions; // Position of the current document in every list
+    size_t shortest;
+    size_t cursor; // Entries of the shortest list consumed
+    bool missing; // A word is not indexed, so nothing matches
+
+    void chooseShortest( );
+};
+
+inline QueryView::QueryView( vector<PostingList> postings )
+          : lists( std::move( postings ) ), positions( lists.size( ) ), shortest( 0 ), cursor( 0 ), missing( false )
+{
+    chooseShortest( );
+}
+
+template <class Lookup>
+QueryView::QueryView( const vector<string> & words, Lookup lookup )
+          : positions( words.size( ) ), shortest( 0 ), cursor( 0 ), missing( false )
+{
+    lists.reserve( words.size( ) );
+    for ( const string & word : words )
+    {
+        const WordItem * item = lookup( word );
+        if ( item == nullptr )
+            missing = true;    // keep looking up, the lookups are part of the query
+        lists.push_back( item == nullptr ? PostingList( ) : item->documents );
+    }
+    chooseShortest( );
+}
+
+inline void QueryView::chooseShortest( )
+{
+    for ( size_t i = 0; i < lists.size( ); i++ )
+        if ( lists[ i ].size( ) < lists[ shortest ].size( ) )
+            shortest = i;
+}
+
+inline bool QueryView::next( )
+{
+    if ( missing || lists.empty( ) )
+        return false;
+    const PostingList & walked = lists[ shortest ];
+    while ( cursor < walked.size( ) )
+    {
+        uint32_t document = walked.docId( cursor );
+        positions[ shortest ] = int( cursor++ );
+        size_t i = 0;
+        for ( ; i < lists.size( ); i++ )
+        {
+            if ( i == shortest )
+                continue;
+            positions[ i ] = lists[ i ].find( document );
+            if ( positions[ i ] == -1 )
+                break;
+        }
+        if ( i == lists.size( ) )
+            return true;
+    }
+    return false;
+}
+
+// Function to append to matches the documents that appear in every list,
+// in document id order
+inline void intersectLists(const vector<PostingList> & lists, vector<QueryMatch> & matches) {
+
+    QueryView view(lists);
+    QueryMatch match;
+    while (view.next()) {
+        match.document = view.document();
+        match.documentName = string(view.name());
+        match.counts.clear();
+        for (size_t i = 0; i < view.words(); i++)
+            match.counts.push_back(view.count(i));
+        matches.push_back(match);
+    }
+}
+
+// Function to fill result.matches with the documents that appear in every posting list.
+// postings[i] belongs to result.words[i] and is nullptr when the word is not indexed.
+inline void intersectPostings(const vector<const WordItem *> & postings, QueryResult & result) {
+
+    result.matches.clear();
+    vector<PostingList> lists;
+    for (const WordItem * item : postings) {
+        if (item == nullptr)
+            return; // A missing word means no document contains the whole query
+        lists.push_back(item->documents);
+    }
+    intersectLists(lists, result.matches);
+}
+
+// Function to evaluate one parsed query. lookup(word) returns the word's
+// WordItem, or nullptr if the word is not in the dictionary.
+template <class Lookup>
+QueryResult evaluateQuery(const vector<string> & words, Lookup lookup) {
+
+    QueryResult result;
+    result.words = words;
+    vector<const WordItem *> postings;
+    for (const string & word : words)
+        postings.push_back(lookup(word));
+    intersectPostings(postings, result);
+    return result;
+}
+
+// Function to evaluate a batch of query lines. Every distinct word in the
+// batch is looked up once and its posting list is shared by all queries.
+template <class Lookup>
+vector<QueryResult> evaluateBatch(const vector<string> & queries, Lookup lookup, BatchStats * stats = nullptr) {
+
+    vector<QueryResult> results(queries.size());
+    unordered_map<string, const WordItem *> postings;
+    size_t words = 0;
+
+    for (int i = 0; i < queries.size(); i++) {
+        results[i].words = parseQuery(queries[i]);
+        words += results[i].words.size();
+        for (const string & word : results[i].words)
+            postings.emplace(word, nullptr);
+    }
+
+    for (auto & entry : postings)
+        entry.second = lookup(entry.first);
+
+    vector<const WordItem *> lists;
+    for (QueryResult & result : results) {
+        lists.clear();
+        for (const string & word : result.words)
+            lists.push_back(postings.find(word)->second);
+        intersectPostings(lists, result);
+    }
+
+    if (stats != nullptr) {
+        stats->queries += queries.size();
+        stats->words += words;
+        stats->lookups += postings.size();
+    }
+    return results;
+}
+
+// Function to print a query result in the format of the interactive loop
+inline void printQueryResult(ostream & out, const QueryResult & result) {
+
+    if (result.matches.empty()) {
+        out << "No document contains the given query" << endl;
+        return;
+    }
+    for (const QueryMatch & match : result.matches) {
+        out << "in Document " << match.documentName << ", ";
+        for (int j = 0; j < result.words.size(); j++) {
+            out << result.words[j] << " found " << match.counts[j] << " times";
+            out << (j + 1 == result.words.size() ? "." : ", ");
+        }
+        out << endl;
+    }
+}
+
+// Function to print the documents of a query view in the format of the
+// interactive loop; the view is rewound first
+inline void printQueryView(ostream & out, QueryView & view, const vector<string> & words) {
+
+    view.rewind();
+    if (!view.next()) {
+        out << "No document contains the given query" << endl;
+        return;
+    }
+    do {
+        out << "in Document " << view.name() << ", ";
+        for (int j = 0; j < words.size(); j++) {
+            out << words[j] << " found " << view.count(j) << " times";
+            out << (j + 1 == words.size() ? "." : ", ");
+        }
+        out << endl;
+    } while (view.next());
+}
+
+// Function to read a query log, one query per line. Blank lines, ENDOFINPUT
+// and remove commands are skipped because batches are read-only.
+inline vector<string> readQueryLog(const string & path) {
+
+    vector<string> queries;
+    ifstream file(path);
+    string line;
+    while (getline(file, line)) {
+        vector<string> words = parseQuery(line);
+        if (line == "ENDOFINPUT" || words.empty() || words[0] == "remove")
+            continue;
+        queries.push_back(line);
+    }
+    return queries;
+}
+
+// Function to sample count queries from the log with Zipfian popularity:
+// the i-th distinct line is picked with probability proportional to 1 / i^skew.
+inline vector<string> zipfianReplay(const vector<string> & log, size_t count, double skew, unsigned seed = 42) {
+
+    vector<string> distinct;
+    unordered_map<string, int> seen;
+    for (const string & line : log) {
+        if (seen.emplace(line, 0).second)
+            distinct.push_back(line);
+    }
+
+    vector<double> cumulative;
+    double total = 0;
+    for (int i = 0; i < distinct.size(); i++) {
+        total += 1.0 / pow(i + 1, skew);
+        cumulative.push_back(total);
+    }
+
+    vector<string> replay;
+    if (distinct.empty())
+        return replay;
+    mt19937 generator(seed);
+    uniform_real_distribution<double> uniform(0.0, total);
+    for (size_t i = 0; i < count; i++) {
+        size_t rank = lower_bound(cumulative.begin(), cumulative.end(), uniform(generator)) - cumulative.begin();
+        replay.push_back(distinct[min(rank, distinct.size() - 1)]);
+    }
+    return replay;
+}
+
+// Function to measure the mean latency of single-word lookups, for words in
+// the vocabulary (hits) and for the same words with a suffix appended (misses)
+template <class Lookup>
+void benchmarkLookups(ostream & out, const string & name, const vector<string> & vocabulary, Lookup lookup) {
+
+    if (vocabulary.empty())
+        return;
+    vector<string> hits = vocabulary, misses;
+    shuffle(hits.begin(), hits.end(), mt19937(7));
+    for (const string & word : hits)
+        misses.push_back(word + "qzx");
+
+    size_t found = 0;
+    auto start = chrono::high_resolution_clock::now();
+    for (const string & word : hits)
+        found += lookup(word) != nullptr;
+    double hitNanos = (double) elapsedNanos(start) / hits.size();
+
+    start = chrono::high_resolution_clock::now();
+    for (const string & word : misses)
+        found += lookup(word) != nullptr;
+    double missNanos = (double) elapsedNanos(start) / misses.size();
+
+    out << name << " lookup: " << hitNanos << " ns per hit, " << missNanos << " ns per miss ("
+        << found << " of " << hits.size() << " found)" << endl;
+}
+
+// Function to time a miss-heavy workload (nine absent words for every present
+// one) with plain lookups and with mayContain() consulted first. Also reports
+// how many absent words the guard let through.
+template <class Lookup, class Guard>
+void benchmarkGuard(ostream & out, const string & name, const vector<string> & vocabulary, Lookup lookup, Guard mayContain) {
+
+    if (vocabulary.empty())
+        return;
+    vector<string> workload;
+    for (const string & word : vocabulary) {
+        workload.push_back(word);
+        for (int i = 0; i < 9; i++)
+            workload.push_back(word + char('0' + i) + "qzx");
+    }
+    shuffle(workload.begin(), workload.end(), mt19937(7));
+
+    size_t found = 0, passed = 0;
+    auto start = chrono::high_resolution_clock::now();
+    for (const string & word : workload)
+        found += lookup(word) != nullptr;
+    double plainNanos = (double) elapsedNanos(start) / workload.size();
+
+    start = chrono::high_resolution_clock::now();
+    for (const string & word : workload)
+        if (mayContain(word)) {
+            passed++;
+            found += lookup(word) != nullptr;
+        }
+    double guardedNanos = (double) elapsedNanos(start) / workload.size();
+
+    size_t misses = workload.size() - vocabulary.size();
+    out << name << " miss-heavy lookup (90% misses): " << plainNanos << " ns unguarded, " << guardedNanos
+        << " ns with the Bloom guard, " << 100.0 * (passed - vocabulary.size()) / misses
+        << "% of misses passed the guard (" << found / 2 << " of " << vocabulary.size() << " found)" << endl;
+}
+
+// Function to measure batch throughput for batch sizes 1, 100 and 10K.
+// The log is repeated until it fills at least one batch of the largest size.
+template <class Lookup>
+void benchmarkBatches(ostream & out, const string & name, const vector<string> & log, Lookup lookup) {
+
+    static const size_t BATCH_SIZES[] = { 1, 100, 10000 };
+    if (log.empty())
+        return;
+
+    vector<string> queries;
+    while (queries.size() < 10000)
+        queries.insert(queries.end(), log.begin(), log.end());
+
+    for (size_t batchSize : BATCH_SIZES) {
+
+        BatchStats stats;
+        size_t matches = 0;
+        auto start = chrono::high_resolution_clock::now();
+        for (size_t offset = 0; offset < queries.size(); offset += batchSize) {
+
+            size_t last = min(offset + batchSize, queries.size());
+            vector<string> batch(queries.begin() + offset, queries.begin() + last);
+            for (const QueryResult & result : evaluateBatch(batch, lookup, &stats))
+                matches += result.matches.size();
+        }
+        double seconds = chrono::duration<double>(chrono::high_resolution_clock::now() - start).count();
+
+        out << name << " batch size " << batchSize << ": " << (size_t) (stats.queries / seconds) << " queries/s, "
+            << stats.lookups << " lookups for " << stats.words << " query words, "
+            << matches << " matches" << endl;
+    }
+}
+
+#endif /* Query_h */
@@ -0,0 +1,122 @@
+#ifndef Replay_h
+#define Replay_h
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <thread>
+#include <mutex>
+#include <shared_mutex>
+#include <atomic>
+#include "QUERY.h"
+#include "CACHE.h"
+#include "STATS.h"
+
+using namespace std;
+
+// Function to read a replay log, one query or "remove <word>" command per line
+inline vector<string> readReplayLog(const string & path) {
+
+    vector<string> lines;
+    ifstream file(path);
+    string line;
+    while (getline(file, line)) {
+        if (line == "ENDOFINPUT")
+            break;
+        if (!parseQuery(line).empty())
+            lines.push_back(line);
+    }
+    return lines;
+}
+
+// Function to replay a log against one structure with the given number of
+// threads and report sustained QPS and latency percentiles. Nothing is printed
+// per query. Queries share the index; a remove command takes it exclusively
+// and removes the word through removeWord(word). The index invalidates the
+// cache itself (see SearchIndex::attachCache), which is safe without the
+// cache lock because every cache access happens under the shared index lock.
+// Built with SEARCH_STATS the structures' counters are not thread safe, so
+// only use concurrency 1 for such builds.
+template <class Lookup, class Remove>
+void replayQueries(ostream & out, const string & name, const vector<string> & log, int concurrency,
+                   QueryCache * cache, Lookup lookup, Remove removeWord) {
+
+    shared_mutex indexLock;
+    mutex cacheLock;
+    atomic<size_t> next(0), removes(0), matches(0);
+    vector<vector<long long>> latencies(concurrency);
+
+    auto worker = [&](int id) {
+        for (size_t i = next++; i < log.size(); i = next++) {
+
+            auto start = chrono::high_resolution_clock::now();
+            vector<string> words = parseQuery(log[i]);
+
+            if (words[0] == "remove") {
+                if (words.size() > 1) {
+                    unique_lock<shared_mutex> exclusive(indexLock);
+                    removeWord(words[1]);
+                }
+                removes++;
+                continue;
+            }
+
+            QueryResult result;
+            {
+                // The shared lock is held until the result is cached, so a
+                // remove cannot slip in between evaluation and cache insert
+                shared_lock<shared_mutex> shared(indexLock);
+                if (cache == nullptr)
+                    result = evaluateQuery(words, lookup);
+                else {
+                    vector<string> canonical = canonicalWords(words);
+                    bool hit = false;
+                    {
+                        lock_guard<mutex> guard(cacheLock);
+                        const QueryResult * cached = cache->lookup(canonical);
+                        if (cached != nullptr) {
+                            result = projectResult(*cached, words);
+                            hit = true;
+                        }
+                    }
+                    if (!hit) {
+                        QueryResult fresh = evaluateQuery(canonical, lookup);
+                        result = projectResult(fresh, words);
+                        lock_guard<mutex> guard(cacheLock);
+                        cache->insert(canonical, fresh);
+                    }
+                }
+            }
+            matches += result.matches.size();
+            latencies[id].push_back(elapsedNanos(start));
+        }
+    };
+
+    auto start = chrono::high_resolution_clock::now();
+    vector<thread> threads;
+    for (int t = 1; t < concurrency; t++)
+        threads.emplace_back(worker, t);
+    worker(0);
+    for (thread & t : threads)
+        t.join();
+    double seconds = elapsedNanos(start) / 1e9;
+
+    vector<long long> all;
+    for (const vector<long long> & samples : latencies)
+        all.insert(all.end(), samples.begin(), samples.end());
+
+    out << name << " replay: " << all.size() << " queries, " << removes << " removes, "
+        << concurrency << " thread(s), " << seconds << " s, " << (size_t) (all.size() / seconds) << " QPS, "
+        << matches << " matching documents" << endl;
+    out << "  latency mean " << meanNanos(all) << " ns, p50 " << percentileNanos(all, 50)
+        << " ns, p90 " << percentileNanos(all, 90) << " ns, p99 " << percentileNanos(all, 99)
+        << " ns, p99.9 " << percentileNanos(all, 99.9) << " ns, max " << percentileNanos(all, 100) << " ns" << endl;
+    if (cache != nullptr) {
+        CacheStats stats = cache->stats();
+        out << "  cache hit rate " << stats.hitRate() << ", " << stats.evictions << " evictions, "
+            << stats.invalidations << " invalidations" << endl;
+    }
+}
+
+#endif /* Replay_h */
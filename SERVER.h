@@ -0,0 +1,255 @@
+#ifndef Server_h
+#define Server_h
+
+#include <string>
+#include <vector>
+#include <sstream>
+#include <iostream>
+#include <atomic>
+#include <mutex>
+#include <unordered_set>
+#include "QUERY.h"
+#include "THREADPOOL.h"
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <cstring>
+#endif
+
+using namespace std;
+
+// Line protocol of the query server:
+//   request:  one query per line
+//   response: the lines printQueryResult() prints, followed by an empty line
+// "QUIT" closes the connection and "SHUTDOWN" stops the server. The index is
+// read-only while serving, so "remove" commands are answered with an error.
+
+// Function to answer one request line of the server protocol
+template <class Lookup>
+string answerRequest(const string & line, Lookup lookup) {
+
+    vector<string> words = parseQuery(line);
+    if (!words.empty() && words[0] == "remove")
+        return "ERROR the index is read-only while serving\n\n";
+
+    ostringstream response;
+    printQueryResult(response, evaluateQuery(words, lookup));
+    response << "\n";
+    return response.str();
+}
+
+#ifdef __linux__
+
+// Struct to hold the state of one client connection
+struct ServerConnection {
+
+    int fd;
+    string input; // Bytes received but not yet terminated by a newline
+};
+
+// Function to open a listening socket on a Unix-domain path, or on localhost:port
+// when the path is empty. Returns -1 on failure.
+inline int openListener(const string & unixPath, int port) {
+
+    int fd;
+    if (unixPath != "") {
+        sockaddr_un address = {};
+        address.sun_family = AF_UNIX;
+        if (unixPath.size() >= sizeof(address.sun_path))
+            return -1;
+        strcpy(address.sun_path, unixPath.c_str());
+        unlink(unixPath.c_str());
+        fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0);
+        if (fd < 0 || ::bind(fd, (sockaddr *) &address, sizeof(address)) < 0) {
+            if (fd >= 0)
+                close(fd);
+            return -1;
+        }
+    }
+    else {
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(port);
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+        int reuse = 1;
+        if (fd >= 0)
+            setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        if (fd < 0 || ::bind(fd, (sockaddr *) &address, sizeof(address)) < 0) {
+            if (fd >= 0)
+                close(fd);
+            return -1;
+        }
+    }
+    if (listen(fd, SOMAXCONN) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Function to write the whole buffer to a non-blocking socket, false if the peer is gone
+inline bool writeAll(int fd, const string & data) {
+
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (n > 0)
+            sent += n;
+        else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            pollfd writable = { fd, POLLOUT, 0 };
+            poll(&writable, 1, 1000);
+        }
+        else if (n < 0 && errno == EINTR)
+            continue;
+        else
+            return false;
+    }
+    return true;
+}
+
+// Function to serve queries until a client sends SHUTDOWN. One thread runs the
+// epoll loop that accepts connections and waits for input; connections are
+// registered EPOLLONESHOT, so a readable connection is owned by exactly one
+// pool worker, which answers every complete line in order and then re-arms it.
+// lookup must be safe to call from several threads at once.
+template <class Lookup>
+int serveQueries(ostream & out, const string & unixPath, int port, int workers, Lookup lookup) {
+
+    int listener = openListener(unixPath, port);
+    if (listener < 0) {
+        out << "Cannot listen on " << (unixPath != "" ? unixPath : "127.0.0.1:" + to_string(port))
+            << ": " << strerror(errno) << endl;
+        return 1;
+    }
+    int epoll = epoll_create1(0);
+    epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.ptr = nullptr; // nullptr marks the listener
+    epoll_ctl(epoll, EPOLL_CTL_ADD, listener, &event);
+
+    out << "Serving on " << (unixPath != "" ? unixPath : "127.0.0.1:" + to_string(port))
+        << " with " << workers << " worker(s)" << endl;
+
+    atomic<bool> running(true);
+    atomic<long long> requests(0);
+    mutex connectionsLock;
+    unordered_set<ServerConnection *> connections;
+
+    auto closeConnection = [&](ServerConnection * connection) {
+        close(connection->fd); // also removes it from the epoll set
+        lock_guard<mutex> guard(connectionsLock);
+        connections.erase(connection);
+        delete connection;
+    };
+
+    auto handle = [&](ServerConnection * connection) {
+        bool open = true;
+        char buffer[4096];
+        for (;;) {
+            ssize_t n = recv(connection->fd, buffer, sizeof(buffer), 0);
+            if (n > 0)
+                connection->input.append(buffer, n);
+            else if (n < 0 && errno == EINTR)
+                continue;
+            else {
+                if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK))
+                    open = false;
+                break;
+            }
+        }
+
+        string response;
+        size_t start = 0, end;
+        while ((end = connection->input.find('\n', start)) != string::npos) {
+            string line = connection->input.substr(start, end - start);
+            start = end + 1;
+            if (!line.empty() && line.back() == '\r')
+                line.pop_back();
+            if (line == "QUIT") {
+                open = false;
+                break;
+            }
+            if (line == "SHUTDOWN") {
+                running = false;
+                open = false;
+                break;
+            }
+            response += answerRequest(line, lookup);
+            requests++;
+        }
+        connection->input.erase(0, start);
+
+        if (!response.empty() && !writeAll(connection->fd, response))
+            open = false;
+        if (!open) {
+            closeConnection(connection);
+            return;
+        }
+        epoll_event rearm = {};
+        rearm.events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT;
+        rearm.data.ptr = connection;
+        epoll_ctl(epoll, EPOLL_CTL_MOD, connection->fd, &rearm);
+    };
+
+    {
+        ThreadPool pool(workers);
+        epoll_event events[64];
+        while (running) {
+            int ready = epoll_wait(epoll, events, 64, 200);
+            for (int i = 0; i < ready; i++) {
+
+                if (events[i].data.ptr != nullptr) {
+                    ServerConnection * connection = (ServerConnection *) events[i].data.ptr;
+                    pool.submit([&handle, connection] { handle(connection); });
+                    continue;
+                }
+
+                int client;
+                while ((client = accept4(listener, nullptr, nullptr, SOCK_NONBLOCK)) >= 0) {
+                    ServerConnection * connection = new ServerConnection{ client, "" };
+                    {
+                        lock_guard<mutex> guard(connectionsLock);
+                        connections.insert(connection);
+                    }
+                    epoll_event added = {};
+                    added.events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT;
+                    added.data.ptr = connection;
+                    epoll_ctl(epoll, EPOLL_CTL_ADD, client, &added);
+                }
+            }
+        }
+        pool.wait();
+    }
+
+    for (ServerConnection * connection : connections) {
+        close(connection->fd);
+        delete connection;
+    }
+    close(epoll);
+    close(listener);
+    if (unixPath != "")
+        unlink(unixPath.c_str());
+    out << "Server stopped after " << requests << " requests" << endl;
+    return 0;
+}
+
+#else
+
+template <class Lookup>
+int serveQueries(ostream & out, const string &, int, int, Lookup) {
+    out << "Server mode needs epoll and is only available on Linux" << endl;
+    return 1;
+}
+
+#endif /* __linux__ */
+
+#endif /* Server_h */
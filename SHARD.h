@@ -0,0 +1,554 @@
+#ifndef Shard_h
+#define Shard_h
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <memory>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <chrono>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include "PIPELINE.h"
+#include "QUERY.h"
+#include "STATS.h"
+#include "THREADPOOL.h"
+#include "PARALLEL.h"
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <signal.h>
+#endif
+
+using namespace std;
+
+// Document sharding: the documents are split over N independent indexes
+// (shards), each with its own term pool, dictionary and posting store, so
+// shards can be built at the same time and saved one file each. Every
+// document lives in exactly one shard, so a query is answered by asking
+// every shard and concatenating the matches (scatter-gather); the document
+// ids come from the shared pool of document names, so the merged matches
+// sort back into ingestion order. The document with id d goes to shard
+// d % N, so a file listed twice is one document of one shard.
+
+// Layout of a saved shard, numbers are 32-bit in native byte order:
+//   "SESHARD1"
+//   document count, then the id and name of every document in the shard
+//   word count, then for every word its text, its posting count and its
+//   (document id, count) pairs
+// Strings are their length followed by their bytes.
+
+// Function to write a number of a saved shard
+inline void writeNumber(ostream & out, uint32_t x) {
+    out.write((const char *) &x, sizeof(x));
+}
+
+// Function to read a number of a saved shard, false at the end of the input
+inline bool readNumber(istream & in, uint32_t & x) {
+    return (bool) in.read((char *) &x, sizeof(x));
+}
+
+// Function to write a string of a saved shard
+inline void writeText(ostream & out, string_view text) {
+    writeNumber(out, uint32_t(text.size()));
+    out.write(text.data(), text.size());
+}
+
+// Function to read a string of a saved shard
+inline bool readText(istream & in, string & text) {
+    uint32_t length;
+    if (!readNumber(in, length))
+        return false;
+    text.resize(length);
+    return (bool) in.read(&text[0], length);
+}
+
+// Function to save a finalized index. Returns false if the stream failed.
+template <class Backend>
+bool saveIndex(const SearchIndex<Backend> & index, ostream & out) {
+
+    vector<uint32_t> documents;
+    index.backend().forEach([&](string_view, const WordItem & item) {
+        for (size_t i = 0; i < item.documents.size(); i++)
+            documents.push_back(item.documents.docId(i));
+    });
+    sort(documents.begin(), documents.end());
+    documents.erase(unique(documents.begin(), documents.end()), documents.end());
+
+    out.write("SESHARD1", 8);
+    writeNumber(out, uint32_t(documents.size()));
+    for (uint32_t document : documents) {
+        writeNumber(out, document);
+        writeText(out, documentName(document));
+    }
+    writeNumber(out, uint32_t(index.backend().size()));
+    index.backend().forEach([&](string_view word, const WordItem & item) {
+        writeText(out, word);
+        writeNumber(out, uint32_t(item.documents.size()));
+        for (size_t i = 0; i < item.documents.size(); i++) {
+            writeNumber(out, item.documents.docId(i));
+            writeNumber(out, item.documents.count(i));
+        }
+    });
+    return (bool) out;
+}
+
+// Function to load a saved index into an empty one and finalize it. The
+// document names are interned again, so the ids may differ from the saved
+// ones; interning is not thread safe, so load on one thread. Returns false
+// on a malformed or truncated input.
+template <class Backend>
+bool loadIndex(SearchIndex<Backend> & index, istream & in) {
+
+    char magic[8];
+    if (!in.read(magic, 8) || string(magic, 8) != "SESHARD1")
+        return false;
+
+    uint32_t documents, words, saved, postings;
+    string text;
+    unordered_map<uint32_t, uint32_t> renumber; // Saved document id to current id
+    if (!readNumber(in, documents))
+        return false;
+    for (uint32_t i = 0; i < documents; i++) {
+        if (!readNumber(in, saved) || !readText(in, text))
+            return false;
+        renumber[saved] = sharedDocumentNames().intern(text);
+    }
+
+    if (!readNumber(in, words))
+        return false;
+    vector<pair<uint32_t, uint32_t>> entries;
+    for (uint32_t i = 0; i < words; i++) {
+        if (!readText(in, text) || !readNumber(in, postings))
+            return false;
+        entries.resize(postings);
+        for (auto & entry : entries) {
+            if (!readNumber(in, saved) || !readNumber(in, entry.second) || renumber.count(saved) == 0)
+                return false;
+            entry.first = renumber[saved];
+        }
+        sort(entries.begin(), entries.end()); // the store takes each word's documents in id order
+        index.addSortedWord(text, entries); // in one pass for the AVL tree when the file's words are sorted
+    }
+    index.finalize();
+    return true;
+}
+
+// Function to move the matches of every shard into result, in document id order
+inline void mergeShardResults(vector<QueryResult> & parts, QueryResult & result) {
+
+    for (QueryResult & part : parts)
+        for (QueryMatch & match : part.matches)
+            result.matches.push_back(std::move(match));
+    sort(result.matches.begin(), result.matches.end(),
+         [](const QueryMatch & a, const QueryMatch & b) { return a.document < b.document; });
+}
+
+/**
+ * N search indexes over disjoint sets of documents, built, queried and saved
+ * through the thread pool given to each call.
+ */
+template <class Backend>
+class ShardedIndex
+{
+  public:
+
+    explicit ShardedIndex( int count );
+
+    static const char * name( ) { return Backend::name( ); }
+    static string shardPath( const string & prefix, int shard, int count );
+
+    void build( const vector<string> & files, ThreadPool & pool ); // document id d goes to shard d % size()
+    QueryResult evaluate( const vector<string> & words, ThreadPool & pool ) const;
+    bool save( const string & prefix ) const; // one file per shard
+    bool load( const string & prefix );
+
+    int size( ) const { return int( shards.size( ) ); }
+    const SearchIndex<Backend> & shard( int i ) const { return shards[ i ]->index; }
+
+  private:
+
+    vector<unique_ptr<StandaloneIndex<Backend>>> shards;
+};
+
+template <class Backend>
+ShardedIndex<Backend>::ShardedIndex( int count )
+{
+    for ( int i = 0; i < max( count, 1 ); i++ )
+        shards.emplace_back( new StandaloneIndex<Backend> );
+}
+
+template <class Backend>
+string ShardedIndex<Backend>::shardPath( const string & prefix, int shard, int count )
+{
+    return prefix + "-" + Backend::name( ) + "-" + to_string( shard ) + "-of-" + to_string( count ) + ".idx";
+}
+
+/**
+ * The document names are interned up front on the calling thread; then
+ * every shard reads its documents on its own thread. Shards are picked by
+ * document id, so a file listed twice goes to one shard both times.
+ */
+template <class Backend>
+void ShardedIndex<Backend>::build( const vector<string> & files, ThreadPool & pool )
+{
+    vector<uint32_t> ids;
+    for ( const string & file : files )
+        ids.push_back( sharedDocumentNames( ).intern( file ) );
+
+    auto buildShard = [&]( int s ) {
+        for ( size_t i = 0; i < files.size( ); i++ )
+            if ( ids[ i ] % shards.size( ) == size_t( s ) )
+                shards[ s ]->index.addDocument( files[ i ], ids[ i ] );
+        shards[ s ]->index.finalize( );
+    };
+    parallelFor( pool, size( ), buildShard );
+}
+
+/**
+ * Scatter the query to every shard, gather the matches in document order.
+ */
+template <class Backend>
+QueryResult ShardedIndex<Backend>::evaluate( const vector<string> & words, ThreadPool & pool ) const
+{
+    vector<QueryResult> parts( shards.size( ) );
+    auto evaluateShard = [&]( int s ) {
+        const SearchIndex<Backend> & index = shards[ s ]->index;
+        parts[ s ] = evaluateQuery( words, [&]( const string & word ) { return index.lookup( word ); } );
+    };
+    if ( size( ) == 1 )
+        evaluateShard( 0 );
+    else
+        parallelFor( pool, size( ), evaluateShard );
+
+    QueryResult result;
+    result.words = words;
+    mergeShardResults( parts, result );
+    return result;
+}
+
+template <class Backend>
+bool ShardedIndex<Backend>::save( const string & prefix ) const
+{
+    for ( int s = 0; s < size( ); s++ )
+    {
+        ofstream file( shardPath( prefix, s, size( ) ), ios::binary );
+        if ( !saveIndex( shards[ s ]->index, file ) )
+            return false;
+    }
+    return true;
+}
+
+/**
+ * Load every shard of a saved index with as many shards as this one; the
+ * shards must be empty.
+ */
+template <class Backend>
+bool ShardedIndex<Backend>::load( const string & prefix )
+{
+    for ( int s = 0; s < size( ); s++ )
+    {
+        ifstream file( shardPath( prefix, s, size( ) ), ios::binary );
+        if ( !file || !loadIndex( shards[ s ]->index, file ) )
+            return false;
+    }
+    return true;
+}
+
+#ifdef __linux__
+
+/**
+ * N shards in N child processes. Each child builds its shard, saves it when
+ * given a prefix, reports READY and then answers queries on a pipe: one line
+ * of normalized words in, one line "<document id> <count>..." per match
+ * out, ended by an empty line. The children are forked after the document
+ * names are interned, so their document ids agree with the coordinator's.
+ */
+template <class Backend>
+class ShardProcesses
+{
+  public:
+
+    ShardProcesses( ) : buildNanos( 0 ) { }
+    ~ShardProcesses( ) { stop( ); }
+
+    bool start( const vector<string> & files, int count, const string & prefix );
+    QueryResult evaluate( const vector<string> & words );
+    void stop( );
+    long long buildTime( ) const { return buildNanos; }
+
+  private:
+
+    struct Child {
+
+        pid_t pid;
+        FILE * requests; // Coordinator to child
+        FILE * responses; // Child to coordinator
+    };
+
+    vector<Child> children;
+    long long buildNanos;
+
+    static void serveShard( const vector<string> & files, const vector<uint32_t> & ids, int shard, int count,
+                            const string & prefix, FILE * requests, FILE * responses );
+    static bool readLine( FILE * in, string & line );
+
+    ShardProcesses( const ShardProcesses & ) = delete;
+    const ShardProcesses & operator=( const ShardProcesses & ) = delete;
+};
+
+// Read one line without its newline, false at the end of the input
+template <class Backend>
+bool ShardProcesses<Backend>::readLine( FILE * in, string & line )
+{
+    line.clear( );
+    for ( int c; ( c = fgetc( in ) ) != EOF; )
+    {
+        if ( c == '\n' )
+            return true;
+        line += char( c );
+    }
+    return !line.empty( );
+}
+
+// Body of a child process: build one shard, then answer queries until QUIT
+template <class Backend>
+void ShardProcesses<Backend>::serveShard( const vector<string> & files, const vector<uint32_t> & ids, int shard, int count,
+                                          const string & prefix, FILE * requests, FILE * responses )
+{
+    StandaloneIndex<Backend> shardIndex;
+    SearchIndex<Backend> & index = shardIndex.index;
+    for ( size_t i = 0; i < files.size( ); i++ )
+        if ( ids[ i ] % count == uint32_t( shard ) )
+            index.addDocument( files[ i ], ids[ i ] );
+    index.finalize( );
+    if ( prefix != "" )
+    {
+        ofstream file( ShardedIndex<Backend>::shardPath( prefix, shard, count ), ios::binary );
+        saveIndex( index, file );
+    }
+    fputs( "READY\n", responses );
+    fflush( responses );
+
+    string line;
+    while ( readLine( requests, line ) && line != "QUIT" )
+    {
+        vector<string> words;
+        istringstream split( line );
+        for ( string word; split >> word; )
+            words.push_back( word );
+        QueryResult result = evaluateQuery( words, [&]( const string & word ) { return index.lookup( word ); } );
+        for ( const QueryMatch & match : result.matches )
+        {
+            fprintf( responses, "%u", match.document );
+            for ( int count : match.counts )
+                fprintf( responses, " %d", count );
+            fputc( '\n', responses );
+        }
+        fputc( '\n', responses );
+        fflush( responses );
+    }
+}
+
+/**
+ * Fork one child per shard and wait until every child has built its shard.
+ * Returns false if a pipe or fork fails or a child dies while building.
+ */
+template <class Backend>
+bool ShardProcesses<Backend>::start( const vector<string> & files, int count, const string & prefix )
+{
+    vector<uint32_t> ids;
+    for ( const string & file : files )
+        ids.push_back( sharedDocumentNames( ).intern( file ) );
+    signal( SIGPIPE, SIG_IGN ); // a dead child shows up as a failed read, not a signal
+    cout.flush( );
+
+    auto start = chrono::high_resolution_clock::now( );
+    for ( int s = 0; s < count; s++ )
+    {
+        int down[ 2 ], up[ 2 ];
+        if ( pipe( down ) != 0 )
+            return false;
+        if ( pipe( up ) != 0 )
+        {
+            close( down[ 0 ] );
+            close( down[ 1 ] );
+            return false;
+        }
+        pid_t pid = fork( );
+        if ( pid < 0 )
+            return false;
+        if ( pid == 0 )
+        {
+            // The pipes of the earlier children must not stay open in this one
+            for ( const Child & child : children )
+            {
+                close( fileno( child.requests ) );
+                close( fileno( child.responses ) );
+            }
+            close( down[ 1 ] );
+            close( up[ 0 ] );
+            serveShard( files, ids, s, count, prefix, fdopen( down[ 0 ], "r" ), fdopen( up[ 1 ], "w" ) );
+            _exit( 0 );
+        }
+        close( down[ 0 ] );
+        close( up[ 1 ] );
+        children.push_back( { pid, fdopen( down[ 1 ], "w" ), fdopen( up[ 0 ], "r" ) } );
+    }
+
+    string line;
+    for ( const Child & child : children )
+        if ( !readLine( child.responses, line ) || line != "READY" )
+            return false;
+    buildNanos = elapsedNanos( start );
+    return true;
+}
+
+/**
+ * Send the query to every child before reading any answer, so the shards
+ * work at the same time.
+ */
+template <class Backend>
+QueryResult ShardProcesses<Backend>::evaluate( const vector<string> & words )
+{
+    string request;
+    for ( const string & word : words )
+        request += ( request.empty( ) ? "" : " " ) + word;
+    request += "\n";
+    for ( const Child & child : children )
+    {
+        fputs( request.c_str( ), child.requests );
+        fflush( child.requests );
+    }
+
+    QueryResult result;
+    result.words = words;
+    vector<QueryResult> parts( children.size( ) );
+    string line;
+    for ( size_t s = 0; s < children.size( ); s++ )
+        while ( readLine( children[ s ].responses, line ) && line != "" )
+        {
+            istringstream fields( line );
+            QueryMatch match;
+            fields >> match.document;
+            for ( int count; fields >> count; )
+                match.counts.push_back( count );
+            match.documentName = string( documentName( match.document ) );
+            parts[ s ].matches.push_back( match );
+        }
+    mergeShardResults( parts, result );
+    return result;
+}
+
+template <class Backend>
+void ShardProcesses<Backend>::stop( )
+{
+    for ( const Child & child : children )
+    {
+        fputs( "QUIT\n", child.requests );
+        fclose( child.requests );
+        fclose( child.responses );
+        waitpid( child.pid, nullptr, 0 );
+    }
+    children.clear( );
+}
+
+#endif /* __linux__ */
+
+// Function to check that two results hold the same documents with the same counts
+inline bool sameMatches(const QueryResult & a, const QueryResult & b) {
+
+    if (a.matches.size() != b.matches.size())
+        return false;
+    for (size_t i = 0; i < a.matches.size(); i++) {
+        if (a.matches[i].documentName != b.matches[i].documentName || a.matches[i].counts != b.matches[i].counts)
+            return false;
+    }
+    return true;
+}
+
+// Function to time every query of a log against a sharded index and compare
+// each result with the unsharded index's
+template <class Evaluate, class Lookup>
+void benchmarkShardQueries(ostream & out, const vector<vector<string>> & queries, Evaluate evaluate, Lookup reference) {
+
+    vector<long long> nanos;
+    size_t mismatches = 0;
+    auto begin = chrono::high_resolution_clock::now();
+    for (const vector<string> & words : queries) {
+        auto start = chrono::high_resolution_clock::now();
+        QueryResult result = evaluate(words);
+        nanos.push_back(elapsedNanos(start));
+        mismatches += !sameMatches(result, evaluateQuery(words, reference));
+    }
+    double seconds = elapsedNanos(begin) / 1e9;
+    out << ", " << (size_t) (queries.size() / seconds) << " queries/s with checking, mean "
+        << meanNanos(nanos) / 1000.0 << " us, p99 " << percentileNanos(nanos, 99) / 1000.0 << " us";
+    if (mismatches > 0)
+        out << ", " << mismatches << " RESULTS DIFFER";
+    out << endl;
+}
+
+// Function to build the documents into 1, 2, ... shards (the counts given),
+// in threads or in child processes, and report build time, save and load
+// time when a prefix is given, and query latency for the log. Every result
+// is checked against the unsharded index built from the same documents.
+template <class Backend>
+void benchmarkShards(ostream & out, const SearchIndex<Backend> & unsharded, const vector<string> & files, const vector<int> & counts,
+                     bool processes, const string & prefix, const vector<string> & log) {
+
+    auto reference = [&](const string & word) { return unsharded.lookup(word); };
+    vector<vector<string>> queries;
+    for (const string & line : log)
+        queries.push_back(parseQuery(line));
+
+    for (int count : counts) {
+
+        // One line per count, written at the end: building prints the hash table's rehash notes
+        ostringstream line;
+        line << Backend::name() << " " << count << " shards in " << (processes ? "processes" : "threads");
+#ifdef __linux__
+        if (processes) {
+            ShardProcesses<Backend> group;
+            if (!group.start(files, count, prefix)) {
+                out << line.str() << ": could not start the shard processes" << endl;
+                continue;
+            }
+            line << ": build " << group.buildTime() / 1e6 << " ms";
+            benchmarkShardQueries(line, queries, [&](const vector<string> & words) { return group.evaluate(words); }, reference);
+            out << line.str();
+            continue;
+        }
+#endif
+        ThreadPool pool(count);
+        auto start = chrono::high_resolution_clock::now();
+        unique_ptr<ShardedIndex<Backend>> sharded(new ShardedIndex<Backend>(count));
+        sharded->build(files, pool);
+        line << ": build " << elapsedNanos(start) / 1e6 << " ms";
+
+        // Queries run against the reloaded copy, which checks the round trip
+        if (prefix != "") {
+            start = chrono::high_resolution_clock::now();
+            bool saved = sharded->save(prefix);
+            line << ", save " << elapsedNanos(start) / 1e6 << " ms";
+            start = chrono::high_resolution_clock::now();
+            sharded.reset(new ShardedIndex<Backend>(count));
+            bool loaded = saved && sharded->load(prefix);
+            line << ", load " << elapsedNanos(start) / 1e6 << " ms";
+            if (!loaded) {
+                out << line.str() << ", the saved shards could not be read back" << endl;
+                continue;
+            }
+        }
+        benchmarkShardQueries(line, queries, [&](const vector<string> & words) { return sharded->evaluate(words, pool); }, reference);
+        out << line.str();
+    }
+}
+
+#endif /* Shard_h */
@@ -0,0 +1,452 @@
+#ifndef Spill_h
+#define Spill_h
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <map>
+#include <memory>
+#include <queue>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <chrono>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include "PIPELINE.h"
+#include "SHARD.h"
+#include "STATS.h"
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#endif
+
+using namespace std;
+
+// Memory-bounded ingestion in the style of SPIMI (single-pass in-memory
+// indexing): documents go into an ordinary SearchIndex with a term pool of
+// its own, the run. Once the run's estimated memory reaches the budget it is
+// finalized, written to disk with its words sorted, and dropped with its
+// pool, and a new run starts. At the end the runs are merged k ways into one
+// index file. A run holds whole documents and runs cover increasing document
+// ids, so the postings of a word merge by concatenation in run order.
+//
+// Runs and the merged index use the saved shard layout of SHARD.h, words in
+// sorted order, so loadIndex() reads any of them. Memory stays near the
+// budget while documents are read, plus one document (a document is never
+// split), and the merge holds one word per open run; more runs than
+// SPILL_MERGE_FAN_IN are merged in passes. The budget bounds ingestion only:
+// serving still loads the merged index, which is the compact final size.
+
+static const size_t SPILL_MERGE_FAN_IN = 128; // runs open at once while merging
+
+// Struct to hold what a spilling ingestion did
+struct SpillStats {
+
+    size_t runs = 0;
+    long long tokens = 0;
+    size_t largestRun = 0; // Estimated bytes of the biggest run when it was spilled
+    size_t runBytes = 0; // Bytes of all run files
+    size_t mergedBytes = 0; // Bytes of the merged index file
+    long long ingestNanos = 0; // Reading documents into runs
+    long long spillNanos = 0; // Writing runs
+    long long mergeNanos = 0;
+};
+
+// Function to save a finalized index with its words in sorted order, in the
+// saved shard layout. Returns the bytes written, 0 if the stream failed.
+template <class Backend>
+size_t saveSortedRun(const SearchIndex<Backend> & index, ostream & out) {
+
+    vector<pair<string_view, const WordItem *>> words;
+    vector<uint32_t> documents;
+    index.backend().forEach([&](string_view word, const WordItem & item) {
+        words.emplace_back(word, &item);
+        for (size_t i = 0; i < item.documents.size(); i++)
+            documents.push_back(item.documents.docId(i));
+    });
+    sort(words.begin(), words.end());
+    sort(documents.begin(), documents.end());
+    documents.erase(unique(documents.begin(), documents.end()), documents.end());
+
+    auto start = out.tellp();
+    out.write("SESHARD1", 8);
+    writeNumber(out, uint32_t(documents.size()));
+    for (uint32_t document : documents) {
+        writeNumber(out, document);
+        writeText(out, documentName(document));
+    }
+    writeNumber(out, uint32_t(words.size()));
+    for (const auto & word : words) {
+        const PostingList & postings = word.second->documents;
+        writeText(out, word.first);
+        writeNumber(out, uint32_t(postings.size()));
+        for (size_t i = 0; i < postings.size(); i++) {
+            writeNumber(out, postings.docId(i));
+            writeNumber(out, postings.count(i));
+        }
+    }
+    return out ? size_t(out.tellp() - start) : 0;
+}
+
+// One run being read by the merge: the current word and its postings
+struct RunCursor {
+
+    ifstream in;
+    uint32_t remaining = 0; // Words not read yet
+    string word;
+    vector<pair<uint32_t, uint32_t>> postings; // (document, count)
+
+    // Read the next word, false at the end of the run or on a malformed one
+    bool next() {
+        uint32_t count;
+        if (remaining == 0 || !readText(in, word) || !readNumber(in, count))
+            return false;
+        postings.resize(count);
+        for (auto & posting : postings)
+            if (!readNumber(in, posting.first) || !readNumber(in, posting.second))
+                return false;
+        remaining--;
+        return true;
+    }
+};
+
+// Function to merge sorted runs into one index file. The words come off a
+// heap of run cursors in order; the postings of a word found in several runs
+// are joined in run order, which is document order. Returns the bytes
+// written, 0 on a malformed run or a failed write.
+inline size_t mergeRuns(const vector<string> & runs, const string & outputPath) {
+
+    vector<unique_ptr<RunCursor>> cursors;
+    map<uint32_t, string> documents; // Every document of every run, by id
+    string text;
+    for (const string & path : runs) {
+        cursors.emplace_back(new RunCursor);
+        RunCursor & cursor = *cursors.back();
+        cursor.in.open(path, ios::binary);
+        char magic[8];
+        uint32_t count, document;
+        if (!cursor.in.read(magic, 8) || string(magic, 8) != "SESHARD1" || !readNumber(cursor.in, count))
+            return 0;
+        for (uint32_t i = 0; i < count; i++) {
+            if (!readNumber(cursor.in, document) || !readText(cursor.in, text))
+                return 0;
+            documents[document] = text;
+        }
+        if (!readNumber(cursor.in, cursor.remaining))
+            return 0;
+    }
+
+    ofstream out(outputPath, ios::binary | ios::trunc);
+    out.write("SESHARD1", 8);
+    writeNumber(out, uint32_t(documents.size()));
+    for (const auto & document : documents) {
+        writeNumber(out, document.first);
+        writeText(out, document.second);
+    }
+    auto wordCountAt = out.tellp();
+    writeNumber(out, 0); // Patched once the words are counted
+
+    // Smallest word first, and the earliest run among equal words
+    auto later = [&](size_t a, size_t b) {
+        int order = cursors[a]->word.compare(cursors[b]->word);
+        return order != 0 ? order > 0 : a > b;
+    };
+    priority_queue<size_t, vector<size_t>, decltype(later)> heap(later);
+    for (size_t i = 0; i < cursors.size(); i++) {
+        if (cursors[i]->next())
+            heap.push(i);
+        else if (cursors[i]->remaining != 0)
+            return 0;
+    }
+
+    uint32_t words = 0;
+    vector<pair<uint32_t, uint32_t>> postings;
+    while (!heap.empty()) {
+        size_t first = heap.top();
+        string word = cursors[first]->word;
+        postings.clear();
+        while (!heap.empty() && cursors[heap.top()]->word == word) {
+            size_t run = heap.top();
+            heap.pop();
+            for (const auto & posting : cursors[run]->postings) {
+                if (!postings.empty() && postings.back().first == posting.first)
+                    postings.back().second += posting.second;
+                else
+                    postings.push_back(posting);
+            }
+            if (cursors[run]->next())
+                heap.push(run);
+            else if (cursors[run]->remaining != 0)
+                return 0;
+        }
+        writeText(out, word);
+        writeNumber(out, uint32_t(postings.size()));
+        for (const auto & posting : postings) {
+            writeNumber(out, posting.first);
+            writeNumber(out, posting.second);
+        }
+        words++;
+    }
+    size_t bytes = size_t(out.tellp());
+    out.seekp(wordCountAt);
+    writeNumber(out, words);
+    out.close();
+    return out ? bytes : 0;
+}
+
+/**
+ * Ingestion into runs of at most about budgetBytes each, spilled to
+ * <prefix>-<backend>-run-<i>.idx and merged by finish(). The run files are
+ * removed after the merge.
+ */
+template <class Backend>
+class SpillingIndexer
+{
+  public:
+
+    SpillingIndexer( size_t budgetBytes, const string & prefix );
+
+    void addDocument( const string & file_name, uint32_t document );
+    bool finish( const string & outputPath ); // spill the last run and merge every run into outputPath
+    const SpillStats & stats( ) const { return statistics; }
+    size_t runEstimate( ); // estimated bytes of the current run, measuring the dictionary now and then
+
+    static string runPath( const string & prefix, size_t run );
+
+  private:
+
+    unique_ptr<StandaloneIndex<Backend>> current; // The run being filled
+    size_t budget;
+    string prefix;
+    vector<string> runFiles;
+    SpillStats statistics;
+    size_t sampledWords; // Dictionary size at the last measurement
+    double bytesPerWord; // Dictionary bytes per word at that measurement
+
+    bool spill( );
+};
+
+template <class Backend>
+SpillingIndexer<Backend>::SpillingIndexer( size_t budgetBytes, const string & prefix )
+          : current( new StandaloneIndex<Backend> ), budget( budgetBytes ), prefix( prefix ), sampledWords( 0 ), bytesPerWord( 0 )
+{
+}
+
+template <class Backend>
+string SpillingIndexer<Backend>::runPath( const string & prefix, size_t run )
+{
+    return prefix + "-" + Backend::name( ) + "-run-" + to_string( run ) + ".idx";
+}
+
+/**
+ * The term pool and the posting store report their size from a few vector
+ * sizes. Walking the dictionary is not that cheap, so its bytes per word are
+ * measured again each time the word count has doubled, and scaled between.
+ */
+template <class Backend>
+size_t SpillingIndexer<Backend>::runEstimate( )
+{
+    const SearchIndex<Backend> & index = current->index;
+    size_t words = index.backend( ).size( );
+    if ( words >= 256 && words >= 2 * sampledWords )
+    {
+        bytesPerWord = double( index.backend( ).memoryUsage( ).total( ) ) / words;
+        sampledWords = words;
+    }
+    return index.terms( ).memoryUsage( ).total( ) + index.postings( ).memoryUsage( ).total( ) + size_t( bytesPerWord * words );
+}
+
+/**
+ * Add a whole document to the current run, then spill the run if it
+ * reached the budget.
+ */
+template <class Backend>
+void SpillingIndexer<Backend>::addDocument( const string & file_name, uint32_t document )
+{
+    auto start = chrono::high_resolution_clock::now( );
+    current->index.addDocument( file_name, document );
+    statistics.ingestNanos += elapsedNanos( start );
+    if ( runEstimate( ) >= budget )
+        spill( );
+}
+
+// Write the current run to its file and start an empty one
+template <class Backend>
+bool SpillingIndexer<Backend>::spill( )
+{
+    auto start = chrono::high_resolution_clock::now( );
+    SearchIndex<Backend> & index = current->index;
+    statistics.tokens += index.tokenCount( );
+    statistics.largestRun = max( statistics.largestRun, runEstimate( ) );
+    index.finalize( );
+
+    runFiles.push_back( runPath( prefix, runFiles.size( ) ) );
+    ofstream out( runFiles.back( ), ios::binary | ios::trunc );
+    size_t bytes = saveSortedRun( index, out );
+    statistics.runBytes += bytes;
+    statistics.runs++;
+
+    current.reset( );    // free the run before the next one grows
+    current.reset( new StandaloneIndex<Backend> );
+    sampledWords = 0;
+    statistics.spillNanos += elapsedNanos( start );
+    return bytes > 0;
+}
+
+template <class Backend>
+bool SpillingIndexer<Backend>::finish( const string & outputPath )
+{
+    bool written = true;
+    if ( current->index.tokenCount( ) > 0 || runFiles.empty( ) )
+        written = spill( );
+    current.reset( new StandaloneIndex<Backend> );
+
+    auto start = chrono::high_resolution_clock::now( );
+    for ( size_t pass = 0; written && runFiles.size( ) > SPILL_MERGE_FAN_IN; pass++ )
+    {
+        // Merge neighbouring runs first, which keeps the runs in document order
+        vector<string> merged;
+        for ( size_t first = 0; first < runFiles.size( ); first += SPILL_MERGE_FAN_IN )
+        {
+            vector<string> group( runFiles.begin( ) + first,
+                                  runFiles.begin( ) + min( first + SPILL_MERGE_FAN_IN, runFiles.size( ) ) );
+            merged.push_back( runPath( prefix + "-pass" + to_string( pass + 1 ), merged.size( ) ) );
+            written = written && mergeRuns( group, merged.back( ) ) > 0;
+            for ( const string & run : group )
+                std::remove( run.c_str( ) );
+        }
+        runFiles = merged;
+    }
+    statistics.mergedBytes = written ? mergeRuns( runFiles, outputPath ) : 0;
+    statistics.mergeNanos = elapsedNanos( start );
+    for ( const string & run : runFiles )
+        std::remove( run.c_str( ) );
+    runFiles.clear( );
+    return statistics.mergedBytes > 0;
+}
+
+// Function to ingest files with a memory budget and load the merged index
+// into index, which must be empty. The merged index is written to
+// <prefix>-<backend>-merged.idx and removed once loaded. Returns false if a
+// run, the merge or the load failed.
+template <class Backend>
+bool ingestSpilled(SearchIndex<Backend> & index, const vector<string> & files, size_t budget, const string & prefix,
+                   SpillStats & stats) {
+
+    auto start = chrono::high_resolution_clock::now();
+    SpillingIndexer<Backend> indexer(budget, prefix);
+    for (const string & file : files)
+        indexer.addDocument(file, sharedDocumentNames().intern(file));
+    string merged = prefix + "-" + Backend::name() + "-merged.idx";
+    bool ok = indexer.finish(merged);
+    stats = indexer.stats();
+    if (ok) {
+        ifstream in(merged, ios::binary);
+        ok = loadIndex(index, in);
+    }
+    std::remove(merged.c_str());
+    index.addIngestionTime(elapsedNanos(start) - index.ingestionTime());
+    return ok;
+}
+
+// Function to print what a spilling ingestion did
+inline void printSpillStats(ostream & out, const string & name, const SpillStats & stats) {
+
+    out << name << " spill: " << stats.runs << " runs (largest " << stats.largestRun / 1048576.0 << " MB in memory, "
+        << stats.runBytes / 1048576.0 << " MB on disk), read " << stats.ingestNanos / 1e6 << " ms, spill "
+        << stats.spillNanos / 1e6 << " ms, merge " << stats.mergeNanos / 1e6 << " ms into " << stats.mergedBytes / 1048576.0
+        << " MB" << endl;
+}
+
+#ifdef __linux__
+// Function to read the resident set size of this process in bytes
+inline size_t residentBytes() {
+
+    long pages = 0, resident = 0;
+    FILE * statm = fopen("/proc/self/statm", "r");
+    if (statm != nullptr) {
+        if (fscanf(statm, "%ld %ld", &pages, &resident) != 2)
+            resident = 0;
+        fclose(statm);
+    }
+    return size_t(resident) * size_t(sysconf(_SC_PAGESIZE));
+}
+#endif
+
+// Function to ingest the files once per budget (0 means one run, no spill)
+// and print the throughput. On Linux every budget runs in a child process
+// that reports its peak resident memory, so the budgets do not share a peak.
+template <class Backend>
+void benchmarkSpill(ostream & out, const SearchIndex<Backend> &, const vector<string> & files, const vector<size_t> & budgets,
+                    const string & prefix) {
+
+    vector<uint32_t> documents;
+    for (const string & file : files)
+        documents.push_back(sharedDocumentNames().intern(file));
+
+    for (size_t budget : budgets) {
+
+        auto run = [&]() {
+            ostringstream line;
+#ifdef __linux__
+            size_t startResident = residentBytes();
+#endif
+            auto start = chrono::high_resolution_clock::now();
+            SpillingIndexer<Backend> indexer(budget == 0 ? SIZE_MAX : budget, prefix);
+            for (size_t i = 0; i < files.size(); i++)
+                indexer.addDocument(files[i], documents[i]);
+            bool ok = indexer.finish(prefix + "-" + Backend::name() + "-bench.idx");
+            double seconds = elapsedNanos(start) / 1e9;
+            const SpillStats & stats = indexer.stats();
+            line << Backend::name() << " budget ";
+            if (budget == 0)
+                line << "unlimited";
+            else
+                line << budget / 1048576.0 << " MB";
+            line << ": " << stats.runs << " runs, " << stats.tokens / seconds / 1e6 << " M tokens/s ("
+                 << seconds * 1000 << " ms, merge " << stats.mergeNanos / 1e6 << " ms)";
+#ifdef __linux__
+            rusage usage;
+            getrusage(RUSAGE_SELF, &usage);
+            line << ", peak RSS " << usage.ru_maxrss / 1024.0 << " MB, " << (usage.ru_maxrss * 1024.0 - startResident) / 1048576.0
+                 << " MB above the start";
+#endif
+            if (!ok)
+                line << ", FAILED";
+            std::remove((prefix + "-" + Backend::name() + "-bench.idx").c_str());
+            return line.str();
+        };
+
+#ifdef __linux__
+        int channel[2];
+        if (pipe(channel) == 0) {
+            out.flush();
+            pid_t child = fork();
+            if (child == 0) {
+                close(channel[0]);
+                string line = run();
+                if (write(channel[1], line.data(), line.size()) < 0)
+                    _exit(1);
+                _exit(0);
+            }
+            close(channel[1]);
+            string line;
+            char buffer[512];
+            for (ssize_t n; (n = read(channel[0], buffer, sizeof(buffer))) > 0; )
+                line.append(buffer, n);
+            close(channel[0]);
+            waitpid(child, nullptr, 0);
+            out << line << endl;
+            continue;
+        }
+#endif
+        out << run() << endl;
+    }
+}
+
+#endif /* Spill_h */
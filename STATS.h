@@ -0,0 +1,95 @@
+#ifndef Stats_h
+#define Stats_h
+
+#include <chrono>
+#include <vector>
+#include <algorithm>
+
+using namespace std;
+
+// Hot-path counters for AvlTree and HashTable.
+// Compile with -DSEARCH_STATS to enable them. Without the flag every
+// SEARCH_STAT(...) statement expands to nothing, the structures carry no
+// counter members and stats() returns an all-zero snapshot.
+#ifdef SEARCH_STATS
+#define SEARCH_STAT(statement) statement
+#else
+#define SEARCH_STAT(statement)
+#endif
+
+// Histogram of small non-negative integers (probe lengths, comparisons, rotations).
+// Bucket i counts samples equal to i, the last bucket collects everything larger.
+struct StatHistogram {
+
+    static const int BUCKETS = 32;
+    long long counts[BUCKETS] = {};
+    long long samples = 0; // Number of recorded samples
+    long long total = 0; // Sum of all recorded values
+    int maxValue = 0; // Largest recorded value
+
+    void record(int sample) {
+        counts[sample < BUCKETS - 1 ? sample : BUCKETS - 1]++;
+        samples++;
+        total += sample;
+        if (sample > maxValue)
+            maxValue = sample;
+    }
+
+    double mean() const {
+        return samples == 0 ? 0.0 : (double) total / samples;
+    }
+};
+
+// Snapshot of the HashTable counters
+struct HashTableStats {
+
+    long long finds = 0; // Number of findPos calls
+    long long collisions = 0; // Total probes past the home slot
+    StatHistogram probeLengths; // Collisions per findPos call
+    long long tombstones = 0; // DELETED slots currently in the array
+    long long rehashes = 0; // Number of rehash calls
+    long long rehashNanos = 0; // Total time spent in rehash
+    long long lastRehashNanos = 0; // Duration of the most recent rehash
+    long long maxRehashNanos = 0; // Slowest rehash so far
+    long long tableSize = 0; // Slots in the array, filled in without SEARCH_STATS too
+    long long words = 0; // Active entries
+    double loadFactor = 0; // words / tableSize
+};
+
+// Snapshot of the AvlTree counters
+struct AvlTreeStats {
+
+    long long finds = 0; // Number of find/update calls
+    long long comparisons = 0; // Nodes visited by find/update
+    StatHistogram comparisonsPerFind; // Nodes visited per find/update call
+    long long inserts = 0; // Number of insert calls
+    long long insertRotations = 0; // Single rotations done while inserting
+    StatHistogram rotationsPerInsert;
+    long long removes = 0; // Number of remove calls
+    long long removeRotations = 0; // Single rotations done while removing
+    StatHistogram rotationsPerRemove;
+};
+
+// Nanoseconds elapsed since start
+inline long long elapsedNanos(chrono::high_resolution_clock::time_point start) {
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::high_resolution_clock::now() - start).count();
+}
+
+// Percentile (0-100) of a set of latency samples; sorts the samples
+inline long long percentileNanos(vector<long long> & samples, double percentile) {
+    if (samples.empty())
+        return 0;
+    sort(samples.begin(), samples.end());
+    size_t rank = (size_t) (percentile / 100.0 * (samples.size() - 1) + 0.5);
+    return samples[rank];
+}
+
+// Mean of a set of latency samples
+inline long long meanNanos(const vector<long long> & samples) {
+    long long total = 0;
+    for (long long sample : samples)
+        total += sample;
+    return samples.empty() ? 0 : total / (long long) samples.size();
+}
+
+#endif /* Stats_h */
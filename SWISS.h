@@ -0,0 +1,457 @@
+#ifndef Swiss_h
+#define Swiss_h
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <utility>
+#include "HASH.h"
+#include "STATS.h"
+#include "MEMORY.h"
+
+#if defined( __SSE2__ ) || defined( _M_X64 )
+#include <emmintrin.h>
+#define SWISS_SSE2 1
+#endif
+
+using namespace std;
+
+// Open addressing hash table in the style of Abseil's Swiss table. A control
+// array holds one byte per slot: EMPTY, DELETED, or the low 7 bits of a full
+// slot's hash. The slots are in groups of 16; a lookup picks a group from the
+// high bits of the hash, compares all 16 control bytes with the 7-bit
+// fragment at once (one SSE2 compare, or a plain loop without SSE2) and
+// compares keys only in slots whose byte matched. The search ends at the
+// first group with an EMPTY byte; otherwise it moves on to the next group
+// of a triangular sequence, which visits every group of the power of two
+// table. Keys and values live in a separate slot array, so probing reads
+// one 16-byte control group instead of whole entries.
+template <class HashedObj, class value>
+class SwissTable
+{
+  public:
+
+    static constexpr int GROUP = 16;
+
+    explicit SwissTable( double maxLoad = 0.875, size_t capacity = 0 );
+
+    const value * findValue( const HashedObj & x ) const;
+    value * findValue( const HashedObj & x );
+    template <class Function>
+    void forEach( Function f ) const;    // call f(key, value) for every full slot
+    void update( const HashedObj & x, const value & updated );
+    void update( const HashedObj & x, value && updated );
+
+    void makeEmpty( );
+    void insert( const HashedObj & x, const value & y );
+    void insert( HashedObj && x, value && y );    // moves x and y into the table
+    template <class K, class... Args>
+    void emplace( K && x, Args && ... args );    // constructs the value from args
+    void remove( const HashedObj & x );
+
+    size_t size( ) const { return currentSize; }
+    size_t capacity( ) const { return slots.size( ); }
+    double loadFactor( ) const { return slots.empty( ) ? 0 : double( currentSize ) / slots.size( ); }
+    size_t tombstones( ) const { return deletedCount; }
+    MemoryReport memoryUsage( ) const; // Bytes held by control bytes, slots, keys and values
+
+  private:
+
+    static constexpr int8_t EMPTY = -128; // 0b10000000
+    static constexpr int8_t DELETED = -2; // 0b11111110; full bytes are 0..127
+
+    struct Slot
+    {
+        HashedObj element;
+        value details;
+    };
+
+    vector<int8_t> control; // One byte per slot
+    vector<Slot> slots;
+    size_t groupMask; // Number of groups - 1
+    size_t currentSize;
+    size_t deletedCount;
+    double maxLoad;
+
+    static uint64_t hash( string_view key );
+    static uint32_t matchByte( const int8_t * group, int8_t byte );
+    static uint32_t matchFree( const int8_t * group ); // EMPTY or DELETED
+    static int firstMatch( uint32_t mask ); // lowest set bit of a nonzero mask
+    size_t findPos( const HashedObj & x, uint64_t h ) const; // slot of x, or slots.size() if absent
+    size_t freePos( uint64_t h ) const;
+    void resize( size_t newCapacity );
+};
+
+/**
+ * Construct the table for about capacity entries (at least one group)
+ * that grows once more than maxLoad of its slots are full or deleted.
+ */
+template <class HashedObj, class value>
+SwissTable<HashedObj, value>::SwissTable( double maxLoad, size_t capacity )
+          : groupMask( 0 ), currentSize( 0 ), deletedCount( 0 ), maxLoad( min( max( maxLoad, 0.1 ), 0.9375 ) )
+{
+    size_t slotCount = GROUP;
+    while ( slotCount * this->maxLoad < capacity )
+        slotCount *= 2;
+    resize( slotCount );
+}
+
+// Eight bytes at a time, each word folded in with a multiply, then the
+// MurmurHash3 finalizer: the group comes from the high bits and the control
+// fragment from the low 7, so both ends must be well mixed
+template <class HashedObj, class value>
+uint64_t SwissTable<HashedObj, value>::hash( string_view key )
+{
+    uint64_t h = 0x9e3779b97f4a7c15ULL ^ key.size( );
+    size_t i = 0;
+    for ( ; i + 8 <= key.size( ); i += 8 )
+    {
+        uint64_t word;
+        memcpy( &word, key.data( ) + i, 8 );
+        h = ( h ^ word ) * 0xff51afd7ed558ccdULL;
+        h ^= h >> 29;
+    }
+    uint64_t tail = 0;
+    if ( i < key.size( ) )
+        memcpy( &tail, key.data( ) + i, key.size( ) - i );
+    h ^= tail;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+/**
+ * Bit i of the result is set if control byte i of the group equals byte.
+ */
+template <class HashedObj, class value>
+uint32_t SwissTable<HashedObj, value>::matchByte( const int8_t * group, int8_t byte )
+{
+#ifdef SWISS_SSE2
+    __m128i bytes = _mm_loadu_si128( reinterpret_cast<const __m128i *>( group ) );
+    return uint32_t( _mm_movemask_epi8( _mm_cmpeq_epi8( bytes, _mm_set1_epi8( byte ) ) ) );
+#else
+    uint32_t mask = 0;
+    for ( int i = 0; i < GROUP; i++ )
+        mask |= uint32_t( group[ i ] == byte ) << i;
+    return mask;
+#endif
+}
+
+/**
+ * Bit i of the result is set if slot i of the group is EMPTY or DELETED,
+ * the two control values with the sign bit set.
+ */
+template <class HashedObj, class value>
+uint32_t SwissTable<HashedObj, value>::matchFree( const int8_t * group )
+{
+#ifdef SWISS_SSE2
+    return uint32_t( _mm_movemask_epi8( _mm_loadu_si128( reinterpret_cast<const __m128i *>( group ) ) ) );
+#else
+    uint32_t mask = 0;
+    for ( int i = 0; i < GROUP; i++ )
+        mask |= uint32_t( group[ i ] < 0 ) << i;
+    return mask;
+#endif
+}
+
+template <class HashedObj, class value>
+int SwissTable<HashedObj, value>::firstMatch( uint32_t mask )
+{
+#if defined( __GNUC__ )
+    return __builtin_ctz( mask );
+#else
+    int i = 0;
+    while ( ( mask & 1 ) == 0 )
+    {
+        mask >>= 1;
+        i++;
+    }
+    return i;
+#endif
+}
+
+/**
+ * Probe group after group until x is found or a group has an EMPTY slot.
+ * Return the slot of x, or slots.size() if x is not in the table.
+ */
+template <class HashedObj, class value>
+size_t SwissTable<HashedObj, value>::findPos( const HashedObj & x, uint64_t h ) const
+{
+    int8_t fragment = int8_t( h & 0x7f );
+    size_t group = ( h >> 7 ) & groupMask;
+    for ( size_t step = 1; ; step++ )
+    {
+        const int8_t * bytes = &control[ group * GROUP ];
+        for ( uint32_t match = matchByte( bytes, fragment ); match != 0; match &= match - 1 )
+        {
+            size_t pos = group * GROUP + firstMatch( match );
+            if ( slots[ pos ].element == x )
+                return pos;
+        }
+        if ( matchByte( bytes, EMPTY ) != 0 || step > groupMask )
+            return slots.size( );
+        group = ( group + step ) & groupMask;
+    }
+}
+
+/**
+ * Return the first EMPTY or DELETED slot on the probe sequence of h.
+ * The table always has one, since it grows before it fills up.
+ */
+template <class HashedObj, class value>
+size_t SwissTable<HashedObj, value>::freePos( uint64_t h ) const
+{
+    size_t group = ( h >> 7 ) & groupMask;
+    for ( size_t step = 1; ; step++ )
+    {
+        uint32_t free = matchFree( &control[ group * GROUP ] );
+        if ( free != 0 )
+            return group * GROUP + firstMatch( free );
+        group = ( group + step ) & groupMask;
+    }
+}
+
+template <class HashedObj, class value>
+const value * SwissTable<HashedObj, value>::findValue( const HashedObj & x ) const
+{
+    size_t pos = findPos( x, hash( x ) );
+    return pos == slots.size( ) ? nullptr : &slots[ pos ].details;
+}
+
+/**
+ * Find the details stored for x so they can be updated in place.
+ * The pointer is invalidated by the next insert (which may resize).
+ */
+template <class HashedObj, class value>
+value * SwissTable<HashedObj, value>::findValue( const HashedObj & x )
+{
+    size_t pos = findPos( x, hash( x ) );
+    return pos == slots.size( ) ? nullptr : &slots[ pos ].details;
+}
+
+/**
+ * Visit every full slot, in table order.
+ */
+template <class HashedObj, class value>
+template <class Function>
+void SwissTable<HashedObj, value>::forEach( Function f ) const
+{
+    for ( size_t i = 0; i < slots.size( ); i++ )
+        if ( control[ i ] >= 0 )
+            f( slots[ i ].element, slots[ i ].details );
+}
+
+template <class HashedObj, class value>
+void SwissTable<HashedObj, value>::update( const HashedObj & x, const value & updated )
+{
+    update( x, value( updated ) );
+}
+
+/**
+ * Replace the details of x, moving updated into the table.
+ * Insert x if it is not present.
+ */
+template <class HashedObj, class value>
+void SwissTable<HashedObj, value>::update( const HashedObj & x, value && updated )
+{
+    value * details = findValue( x );
+    if ( details != nullptr )
+        *details = std::move( updated );
+    else
+        emplace( x, std::move( updated ) );
+}
+
+template <class HashedObj, class value>
+void SwissTable<HashedObj, value>::insert( const HashedObj & x, const value & y )
+{
+    emplace( x, y );
+}
+
+template <class HashedObj, class value>
+void SwissTable<HashedObj, value>::insert( HashedObj && x, value && y )
+{
+    emplace( std::move( x ), std::move( y ) );
+}
+
+/**
+ * Insert x with a value constructed from args into the first free slot of
+ * its probe sequence. If x is already present, then do nothing.
+ */
+template <class HashedObj, class value>
+template <class K, class... Args>
+void SwissTable<HashedObj, value>::emplace( K && x, Args && ... args )
+{
+    uint64_t h = hash( x );
+    if ( findPos( x, h ) != slots.size( ) )
+        return;
+    if ( currentSize + deletedCount + 1 > slots.size( ) * maxLoad )
+    {
+        // Mostly tombstones: clean them up in place; otherwise double
+        resize( currentSize + 1 <= slots.size( ) * maxLoad / 2 ? slots.size( ) : slots.size( ) * 2 );
+    }
+    size_t pos = freePos( h );
+    if ( control[ pos ] == DELETED )
+        deletedCount--;
+    control[ pos ] = int8_t( h & 0x7f );
+    slots[ pos ].element = HashedObj( std::forward<K>( x ) );
+    slots[ pos ].details = value( std::forward<Args>( args )... );
+    currentSize++;
+}
+
+/**
+ * Remove x if present. The slot can go back to EMPTY when its group still
+ * has an EMPTY slot: no search ever went past that group, so none can
+ * depend on this slot being taken. Otherwise it becomes a tombstone.
+ */
+template <class HashedObj, class value>
+void SwissTable<HashedObj, value>::remove( const HashedObj & x )
+{
+    size_t pos = findPos( x, hash( x ) );
+    if ( pos == slots.size( ) )
+        return;
+    const int8_t * group = &control[ pos / GROUP * GROUP ];
+    bool keepsSearching = matchByte( group, EMPTY ) == 0;
+    control[ pos ] = keepsSearching ? DELETED : EMPTY;
+    deletedCount += keepsSearching;
+    slots[ pos ] = Slot( );
+    currentSize--;
+}
+
+/**
+ * Move every entry into a table of newCapacity slots (a power of two,
+ * at least one group), dropping the tombstones.
+ */
+template <class HashedObj, class value>
+void SwissTable<HashedObj, value>::resize( size_t newCapacity )
+{
+    vector<int8_t> oldControl = std::move( control );
+    vector<Slot> oldSlots = std::move( slots );
+    control.assign( newCapacity, EMPTY );
+    slots.clear( );
+    slots.resize( newCapacity );
+    groupMask = newCapacity / GROUP - 1;
+    deletedCount = 0;
+    for ( size_t i = 0; i < oldSlots.size( ); i++ )
+        if ( oldControl[ i ] >= 0 )
+        {
+            uint64_t h = hash( oldSlots[ i ].element );
+            size_t pos = freePos( h );
+            control[ pos ] = int8_t( h & 0x7f );
+            slots[ pos ] = std::move( oldSlots[ i ] );
+        }
+}
+
+// Make the table empty, keeping its capacity
+template <class HashedObj, class value>
+void SwissTable<HashedObj, value>::makeEmpty( )
+{
+    control.assign( control.size( ), EMPTY );
+    slots.assign( slots.size( ), Slot( ) );
+    currentSize = 0;
+    deletedCount = 0;
+}
+
+/**
+ * Full slots count as nodes, EMPTY and DELETED ones separately; the
+ * control bytes count as nodes too.
+ */
+template <class HashedObj, class value>
+MemoryReport SwissTable<HashedObj, value>::memoryUsage( ) const
+{
+    MemoryReport report;
+    accountVector( control, report.nodeBytes, report );
+    report.slackBytes += ( slots.capacity( ) - slots.size( ) ) * sizeof( Slot );
+    addAllocation( report, slots.capacity( ) * sizeof( Slot ) );
+    for ( size_t i = 0; i < slots.size( ); i++ )
+    {
+        if ( control[ i ] == EMPTY )
+            report.emptySlotBytes += sizeof( Slot );
+        else if ( control[ i ] == DELETED )
+            report.deletedSlotBytes += sizeof( Slot );
+        else
+        {
+            report.nodeBytes += sizeof( Slot );
+            report.keyBytes += heapBytes( slots[ i ].element );
+            addAllocation( report, heapBytes( slots[ i ].element ) );
+            accountMemory( slots[ i ].details, report );
+        }
+    }
+    return report;
+}
+
+// Function to compare the quadratic probing HashTable with the SwissTable
+// when both hold the same share of their slots. For every load factor both
+// are sized so that up to count random words reach it without a resize, then
+// hits and misses are timed after one untimed pass, so the first touch of
+// fresh pages is not counted. HashTable grows at 0.68, so it sits out the
+// loads above.
+inline void benchmarkSwiss(ostream & out, size_t count, const vector<double> & loads) {
+
+    mt19937 random(23);
+    vector<string> words, absent;
+    for (vector<string> * list : { &words, &absent }) {
+        while (list->size() < count) {
+            string word;
+            int length = 3 + random() % 10;
+            for (int j = 0; j < length; j++)
+                word += char('a' + random() % 26);
+            list->push_back(word + (list == &absent ? "#" : ""));
+        }
+    }
+    sort(words.begin(), words.end());
+    words.erase(unique(words.begin(), words.end()), words.end());
+    shuffle(words.begin(), words.end(), random);
+
+    long long found = 0;
+    auto time = [&](auto & table, const vector<string> & keys) {
+        for (const string & word : keys)
+            found += table.findValue(string_view(word)) != nullptr;
+        auto start = chrono::high_resolution_clock::now();
+        for (const string & word : keys)
+            found += table.findValue(string_view(word)) != nullptr;
+        return (double) elapsedNanos(start) / max<size_t>(keys.size(), 1);
+    };
+
+    for (double load : loads) {
+
+        // Slots of the SwissTable: the largest power of two the words fill to this load
+        size_t slotCount = SwissTable<string_view, int>::GROUP;
+        while (slotCount * 2 * load <= words.size())
+            slotCount *= 2;
+        size_t n = size_t(slotCount * load);
+        vector<string> keys(words.begin(), words.begin() + n);
+
+        SwissTable<string_view, int> swiss(0.9375, size_t(slotCount * 0.9375));
+        auto start = chrono::high_resolution_clock::now();
+        for (size_t i = 0; i < n; i++)
+            swiss.insert(string_view(keys[i]), int(i));
+        double swissInsert = (double) elapsedNanos(start) / max<size_t>(n, 1);
+        out << "load " << swiss.loadFactor() << " (" << n << " words): SWISS insert " << swissInsert << " ns, hit "
+            << time(swiss, keys) << " ns, miss " << time(swiss, absent) << " ns";
+
+        if (load < 0.68) {
+            HashTable<string_view, int> table("", int(n / load));
+            start = chrono::high_resolution_clock::now();
+            for (size_t i = 0; i < n; i++)
+                table.insert(string_view(keys[i]), int(i));
+            double hashInsert = (double) elapsedNanos(start) / max<size_t>(n, 1);
+            float ratio = 0;
+            table.output(ratio);
+            out << "; HASH at load " << ratio << " insert " << hashInsert << " ns, hit " << time(table, keys)
+                << " ns, miss " << time(table, absent) << " ns";
+        }
+        out << endl;
+    }
+    out << "(" << found << " found)" << endl;
+}
+
+#endif /* Swiss_h */
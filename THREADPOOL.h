@@ -0,0 +1,101 @@
+#ifndef ThreadPool_h
+#define ThreadPool_h
+
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+using namespace std;
+
+// Fixed-size pool of worker threads draining one shared task queue
+class ThreadPool
+{
+  public:
+
+    explicit ThreadPool( int threads );
+    ~ThreadPool( );
+
+    void submit( function<void( )> task );
+    void wait( ); // Block until every submitted task has finished
+    int size( ) const { return int( workers.size( ) ); }
+
+  private:
+
+    vector<thread> workers;
+    queue<function<void( )>> tasks;
+    mutex lock;
+    condition_variable available; // Signalled when a task is queued or the pool stops
+    condition_variable idle; // Signalled when the last running task finishes
+    int active;
+    bool stopping;
+
+    void run( );
+
+    ThreadPool( const ThreadPool & ) = delete;
+    const ThreadPool & operator=( const ThreadPool & ) = delete;
+};
+
+inline ThreadPool::ThreadPool( int threads ) : active( 0 ), stopping( false )
+{
+    if ( threads < 1 )
+        threads = 1;
+    for ( int i = 0; i < threads; i++ )
+        workers.emplace_back( [this] { run( ); } );
+}
+
+/**
+ * Finish the queued tasks, then stop and join the workers.
+ */
+inline ThreadPool::~ThreadPool( )
+{
+    {
+        lock_guard<mutex> guard( lock );
+        stopping = true;
+    }
+    available.notify_all( );
+    for ( thread & worker : workers )
+        worker.join( );
+}
+
+inline void ThreadPool::submit( function<void( )> task )
+{
+    {
+        lock_guard<mutex> guard( lock );
+        tasks.push( move( task ) );
+    }
+    available.notify_one( );
+}
+
+inline void ThreadPool::wait( )
+{
+    unique_lock<mutex> guard( lock );
+    idle.wait( guard, [this] { return tasks.empty( ) && active == 0; } );
+}
+
+inline void ThreadPool::run( )
+{
+    for ( ; ; )
+    {
+        function<void( )> task;
+        {
+            unique_lock<mutex> guard( lock );
+            available.wait( guard, [this] { return stopping || !tasks.empty( ); } );
+            if ( tasks.empty( ) )
+                return;    // stopping and nothing left to do
+            task = move( tasks.front( ) );
+            tasks.pop( );
+            active++;
+        }
+
+        task( );
+
+        lock_guard<mutex> guard( lock );
+        if ( --active == 0 && tasks.empty( ) )
+            idle.notify_all( );
+    }
+}
+
+#endif /* ThreadPool_h */
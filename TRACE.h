@@ -0,0 +1,236 @@
+#ifndef Trace_h
+#define Trace_h
+
+#include <string>
+#include <vector>
+#include <array>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <cstdint>
+
+using namespace std;
+
+// Per-phase latency tracing of queries. Every phase of every query is timed
+// into an HDR histogram of its track (one track per structure, plus one for
+// the parsing they share), and with a trace file each timing is also kept as
+// a Chrome trace event, which chrome://tracing and Perfetto open to show
+// where the slow queries spent their time.
+
+static const int HDR_SUB_BITS = 8; // values below 2^HDR_SUB_BITS ns are counted exactly
+static const int HDR_MAX_BITS = 40; // larger values go to the last bucket
+
+/**
+ * High dynamic range histogram of nanosecond latencies: every power of two
+ * above 2^HDR_SUB_BITS is cut into 2^(HDR_SUB_BITS-1) equal buckets, so any
+ * recorded value is known to within 1/128 (better than two significant
+ * digits) with a fixed 35 KB of counters from 1 ns up to 2^HDR_MAX_BITS ns
+ * (about 18 minutes).
+ */
+class HdrHistogram
+{
+  public:
+
+    HdrHistogram( ) : counts( bucketFor( ( 1ULL << HDR_MAX_BITS ) - 1 ) + 1, 0 ), samples( 0 ), total( 0 ), largest( 0 ) { }
+
+    void record( long long nanos );
+    void merge( const HdrHistogram & other );
+    long long valueAtPercentile( double percentile ) const; // highest value of the bucket holding that rank
+
+    long long count( ) const { return samples; }
+    long long mean( ) const { return samples == 0 ? 0 : total / samples; }
+    long long max( ) const { return largest; }
+
+  private:
+
+    vector<long long> counts;
+    long long samples;
+    long long total;
+    long long largest;
+
+    static size_t bucketFor( uint64_t value );
+    static uint64_t highestIn( size_t bucket );
+};
+
+inline size_t HdrHistogram::bucketFor( uint64_t value )
+{
+    const uint64_t half = 1ULL << ( HDR_SUB_BITS - 1 );
+    if ( value < 2 * half )
+        return size_t( value );
+#if defined( __GNUC__ )
+    int top = 63 - __builtin_clzll( value );
+#else
+    int top = 0;
+    while ( value >> ( top + 1 ) )
+        top++;
+#endif
+    int shift = top - ( HDR_SUB_BITS - 1 );
+    return size_t( 2 * half + ( shift - 1 ) * half + ( ( value >> shift ) - half ) );
+}
+
+inline uint64_t HdrHistogram::highestIn( size_t bucket )
+{
+    const uint64_t half = 1ULL << ( HDR_SUB_BITS - 1 );
+    if ( bucket < 2 * half )
+        return bucket;
+    int shift = int( ( bucket - 2 * half ) / half ) + 1;
+    uint64_t mantissa = half + ( bucket - 2 * half ) % half;
+    return ( ( mantissa + 1 ) << shift ) - 1;
+}
+
+inline void HdrHistogram::record( long long nanos )
+{
+    uint64_t value = nanos < 0 ? 0 : uint64_t( nanos );
+    size_t bucket = bucketFor( value );
+    counts[ bucket < counts.size( ) ? bucket : counts.size( ) - 1 ]++;
+    samples++;
+    total += nanos;
+    if ( nanos > largest )
+        largest = nanos;
+}
+
+inline void HdrHistogram::merge( const HdrHistogram & other )
+{
+    for ( size_t i = 0; i < counts.size( ); i++ )
+        counts[ i ] += other.counts[ i ];
+    samples += other.samples;
+    total += other.total;
+    if ( other.largest > largest )
+        largest = other.largest;
+}
+
+inline long long HdrHistogram::valueAtPercentile( double percentile ) const
+{
+    if ( samples == 0 )
+        return 0;
+    long long rank = (long long) ( percentile / 100.0 * samples + 0.5 );
+    rank = rank < 1 ? 1 : rank;
+    long long seen = 0;
+    for ( size_t i = 0; i < counts.size( ); i++ )
+    {
+        seen += counts[ i ];
+        if ( seen >= rank )    // the last bucket also holds everything past its range
+            return i + 1 < counts.size( ) && (long long) highestIn( i ) < largest ? (long long) highestIn( i ) : largest;
+    }
+    return largest;
+}
+
+// The phases of answering one query
+enum QueryPhase { PhaseParse, PhaseLookup, PhaseMerge, PhaseAssemble, PhaseOutput, QUERY_PHASES };
+
+// Function to name a query phase
+inline const char * phaseName(int phase) {
+    static const char * names[QUERY_PHASES] = { "parse", "lookup", "posting merge", "result assembly", "output" };
+    return names[phase];
+}
+
+static const size_t TRACE_EVENT_LIMIT = 1 << 20; // events kept for the trace file, later ones are only counted
+
+/**
+ * Collects phase timings on one thread. Tracks are named once with track()
+ * and every timing goes to the histogram of its track and phase; with
+ * keepEvents( true ) it is also kept as a trace event. beginQuery( ) numbers
+ * the queries, so the events of one query can be told apart in the trace.
+ */
+class PhaseTracer
+{
+  public:
+
+    PhaseTracer( ) : epoch( chrono::high_resolution_clock::now( ) ), queries( 0 ), dropped( 0 ), keeping( false ) { }
+
+    int track( const string & name );
+    void keepEvents( bool on ) { keeping = on; }
+    void beginQuery( ) { queries++; }
+    void record( int track, QueryPhase phase, chrono::high_resolution_clock::time_point start,
+                 chrono::high_resolution_clock::time_point end );
+
+    const HdrHistogram & histogram( int track, QueryPhase phase ) const { return histograms[ track ][ phase ]; }
+    void print( ostream & out ) const; // percentiles of every phase that has samples
+    bool writeChromeTrace( const string & path ) const; // false if the file could not be written
+
+  private:
+
+    struct Event {
+
+        int track;
+        QueryPhase phase;
+        long long query;
+        long long start; // Nanoseconds since the tracer was made
+        long long duration;
+    };
+
+    chrono::high_resolution_clock::time_point epoch;
+    vector<string> names;
+    vector<array<HdrHistogram, QUERY_PHASES>> histograms;
+    vector<Event> events;
+    long long queries;
+    long long dropped; // Events past TRACE_EVENT_LIMIT
+    bool keeping;
+};
+
+inline int PhaseTracer::track( const string & name )
+{
+    for ( size_t i = 0; i < names.size( ); i++ )
+        if ( names[ i ] == name )
+            return int( i );
+    names.push_back( name );
+    histograms.emplace_back( );
+    return int( names.size( ) - 1 );
+}
+
+inline void PhaseTracer::record( int track, QueryPhase phase, chrono::high_resolution_clock::time_point start,
+                                 chrono::high_resolution_clock::time_point end )
+{
+    long long duration = chrono::duration_cast<chrono::nanoseconds>( end - start ).count( );
+    histograms[ track ][ phase ].record( duration );
+    if ( !keeping )
+        return;
+    if ( events.size( ) >= TRACE_EVENT_LIMIT )
+    {
+        dropped++;
+        return;
+    }
+    long long offset = chrono::duration_cast<chrono::nanoseconds>( start - epoch ).count( );
+    events.push_back( { track, phase, queries, offset, duration } );
+}
+
+inline void PhaseTracer::print( ostream & out ) const
+{
+    out << "Phase latency over " << queries << " queries (ns):" << endl;
+    for ( size_t t = 0; t < names.size( ); t++ )
+        for ( int phase = 0; phase < QUERY_PHASES; phase++ )
+        {
+            const HdrHistogram & h = histograms[ t ][ phase ];
+            if ( h.count( ) == 0 )
+                continue;
+            out << "  " << names[ t ] << " " << phaseName( phase ) << ": " << h.count( ) << " samples, mean " << h.mean( )
+                << ", p50 " << h.valueAtPercentile( 50 ) << ", p90 " << h.valueAtPercentile( 90 ) << ", p99 "
+                << h.valueAtPercentile( 99 ) << ", p99.9 " << h.valueAtPercentile( 99.9 ) << ", max " << h.max( ) << endl;
+        }
+    if ( dropped > 0 )
+        out << "  " << dropped << " events past the trace limit were not kept" << endl;
+}
+
+/**
+ * Chrome trace event format: one complete ("X") event per timing, in
+ * microseconds, with every track as a thread of one process and the query
+ * number in args.
+ */
+inline bool PhaseTracer::writeChromeTrace( const string & path ) const
+{
+    ofstream out( path );
+    out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    for ( size_t t = 0; t < names.size( ); t++ )
+        out << ( t == 0 ? "" : "," ) << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << t
+            << ",\"args\":{\"name\":\"" << names[ t ] << "\"}}";
+    out << fixed << setprecision( 3 );
+    for ( const Event & event : events )
+        out << ",\n{\"name\":\"" << phaseName( event.phase ) << "\",\"cat\":\"query\",\"ph\":\"X\",\"pid\":1,\"tid\":"
+            << event.track << ",\"ts\":" << event.start / 1000.0 << ",\"dur\":" << event.duration / 1000.0
+            << ",\"args\":{\"query\":" << event.query << "}}";
+    out << "\n]}" << endl;
+    return (bool) out;
+}
+
+#endif /* Trace_h */
@@ -0,0 +1,181 @@
+// Load generator for the query server (main --serve / --serve-unix).
+// Opens N connections, each sending queries from a log one at a time and
+// waiting for the answer, and reports QPS and tail latency for every N.
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <sstream>
+#include "QUERY.h"
+#include "STATS.h"
+
+#ifdef __linux__
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <cstring>
+#endif
+
+using namespace std;
+
+#ifdef __linux__
+
+// Function to connect to the server, -1 on failure
+int connectToServer(const string & unixPath, int port) {
+
+    int fd;
+    if (unixPath != "") {
+        sockaddr_un address = {};
+        address.sun_family = AF_UNIX;
+        strncpy(address.sun_path, unixPath.c_str(), sizeof(address.sun_path) - 1);
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd >= 0 && connect(fd, (sockaddr *) &address, sizeof(address)) == 0)
+            return fd;
+    }
+    else {
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(port);
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        int noDelay = 1;
+        if (fd >= 0)
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+        if (fd >= 0 && connect(fd, (sockaddr *) &address, sizeof(address)) == 0)
+            return fd;
+    }
+    if (fd >= 0)
+        close(fd);
+    return -1;
+}
+
+// Function to send one request and read until the empty line that ends the response
+bool roundTrip(int fd, const string & request, string & pending) {
+
+    string line = request + "\n";
+    if (send(fd, line.data(), line.size(), MSG_NOSIGNAL) != (ssize_t) line.size())
+        return false;
+
+    char buffer[4096];
+    for (;;) {
+        size_t end = pending.find("\n\n");
+        if (end != string::npos) {
+            pending.erase(0, end + 2);
+            return true;
+        }
+        ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+        if (n <= 0)
+            return false;
+        pending.append(buffer, n);
+    }
+}
+
+int main(int argc, char * argv[]) {
+
+    string unixPath, queryLog;
+    int port = 0, requests = 2000;
+    bool shutdown = false;
+    vector<int> connectionCounts = { 1, 2, 4, 8, 16, 32 };
+
+    for (int i = 1; i < argc; i++) {
+        string option = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (option == "--port" && hasValue)
+            port = stoi(argv[++i]);
+        else if (option == "--unix" && hasValue)
+            unixPath = argv[++i];
+        else if (option == "--queries" && hasValue)
+            queryLog = argv[++i];
+        else if (option == "--requests" && hasValue)
+            requests = stoi(argv[++i]);
+        else if (option == "--connections" && hasValue) {
+            connectionCounts.clear();
+            istringstream list(argv[++i]);
+            string count;
+            while (getline(list, count, ','))
+                connectionCounts.push_back(stoi(count));
+        }
+        else if (option == "--shutdown")
+            shutdown = true;
+        else {
+            port = -1;
+            break;
+        }
+    }
+    if ((port <= 0 && unixPath == "") || queryLog == "") {
+        cerr << "Usage: " << argv[0] << " (--port <port> | --unix <path>) --queries <log>"
+             << " [--connections 1,2,4,...] [--requests <per connection>] [--shutdown]" << endl;
+        return 1;
+    }
+
+    vector<string> queries = readQueryLog(queryLog);
+    if (queries.empty()) {
+        cerr << "No queries in " << queryLog << endl;
+        return 1;
+    }
+
+    for (int connections : connectionCounts) {
+
+        vector<vector<long long>> latencies(connections);
+        vector<int> failures(connections, 0);
+        auto client = [&](int id) {
+            int fd = connectToServer(unixPath, port);
+            if (fd < 0) {
+                failures[id] = requests;
+                return;
+            }
+            string pending;
+            for (int r = 0; r < requests; r++) {
+                const string & query = queries[(size_t(id) * 7919 + r) % queries.size()];
+                auto start = chrono::high_resolution_clock::now();
+                if (!roundTrip(fd, query, pending)) {
+                    failures[id] = requests - r;
+                    break;
+                }
+                latencies[id].push_back(elapsedNanos(start));
+            }
+            close(fd);
+        };
+
+        auto start = chrono::high_resolution_clock::now();
+        vector<thread> threads;
+        for (int c = 0; c < connections; c++)
+            threads.emplace_back(client, c);
+        for (thread & t : threads)
+            t.join();
+        double seconds = elapsedNanos(start) / 1e9;
+
+        vector<long long> all;
+        int failed = 0;
+        for (int c = 0; c < connections; c++) {
+            all.insert(all.end(), latencies[c].begin(), latencies[c].end());
+            failed += failures[c];
+        }
+        cout << connections << " connection(s): " << (size_t) (all.size() / seconds) << " QPS, p50 "
+             << percentileNanos(all, 50) << " ns, p99 " << percentileNanos(all, 99) << " ns, p99.9 "
+             << percentileNanos(all, 99.9) << " ns, max " << percentileNanos(all, 100) << " ns, "
+             << failed << " failed" << endl;
+    }
+
+    if (shutdown) {
+        int fd = connectToServer(unixPath, port);
+        if (fd >= 0) {
+            send(fd, "SHUTDOWN\n", 9, MSG_NOSIGNAL);
+            close(fd);
+        }
+    }
+    return 0;
+}
+
+#else
+
+int main() {
+    cerr << "The load generator needs POSIX sockets and is only built on Linux" << endl;
+    return 1;
+}
+
+#endif /* __linux__ */
@@ -1,104 +1,94 @@
 #include <fstream>
 #include "BST.h"
-#include "Hash.h"
+#include "HASH.h"
+#include "INDEX.h"
+#include "QUERY.h"
+#include "CACHE.h"
+#include "REPLAY.h"
+#include "OPTIONS.h"
+#include "SERVER.h"
+#include "BACKEND.h"
+#include "PIPELINE.h"
+#include "MPH.h"
+#include "FRONTCODE.h"
+#include "ALLOCS.h"
+#include "BLOOM.h"
+#include "PARALLEL.h"
+#include "SHARD.h"
+#include "INGEST.h"
+#include "EYTZINGER.h"
+#include "SPILL.h"
+#include "BENCH.h"
 #include <iostream>
 #include <sstream>
 #include <string>
 #include <vector>
 #include <unordered_map>
+#include <algorithm>
+#include <chrono>
+#include <tuple>
 
 using namespace std;
 
-// Struct to represent a document item
-struct DocumentItem {
-    
-    string documentName = "";
-    int count = 0; // Count of occurrences of a word in this document
-};
-
-// Struct to represent a word item
-struct WordItem {
-    
-    string word_name = ""; // The word itself
-    vector<DocumentItem> documents; // List of documents containing this word
-};
-
-// Struct to represent word output
-struct WordOutput {
-    
-    string documentName; // Name of the document
-    string word; // Word
-    int count; // Count of occurrences of the word in the document
-};
+// Every structure in this list is built and queried through the same pipeline
+// and shows up in every report and comparison
+typedef tuple<SearchIndex<AvlBackend>, SearchIndex<HashBackend>, SearchIndex<ArtBackend>, SearchIndex<SwissBackend>> Backends;
 
-// Function to convert a string to lowercase
-string toLowercase(string &data) {
-    
-    transform(data.begin(), data.end(), data.begin(),
-                   [](unsigned char c) -> unsigned char { return std::tolower(c); });
-    return data;
-}
-
-// Function to check if a document is already in the vector
+int main(int argc, char * argv[]) {
 
-bool check_document(vector<DocumentItem> vec, string file_name, int & idx){
-    for (int i = 0; i < vec.size(); i++){
-        if (vec[i].documentName == file_name){
-            idx = i;
-            return true;
-        }
+    // Command line options
+    SearchOptions options;
+    if (!parseOptions(argc, argv, options)) {
+        printUsage(cerr, argv[0]);
+        return 1;
     }
-    return false;
-}
 
-// Function to remove punctuation and digits from a word
-void removePunctuationAndDigits(string& word, vector<string> &result) {
-    
-    string temp = "";
-    for (char letter : word) {
-        if (isalpha(letter)) {
-            temp += letter; // Append the character to the result string
-        }
-        else {
-            result.push_back(temp);
-            temp = "";
-        }
+    if (options.internReport > 0) {
+        reportInterning(cout, options.internReport);
+        return 0;
     }
-    result.push_back(temp);
-}
-
-// Function to check if a word is in the vector and add it to a temporary vector
-void isWordInVector(const vector<WordOutput>& vec, vector<WordOutput>& temp, const string& filename) {
-    
-    for (const auto& element : vec) {
-        if (element.documentName == filename)
-            temp.push_back(element); // Word found in vector
+    if (options.bulkBench > 0) {
+        benchmarkBulkLoad(cout, options.bulkBench);
+        return 0;
     }
-}
-
-// Function to check if a word is found in the vector
-bool isFoundWordInVector(const vector<WordOutput>& vec, const string& filename, const string& word) {
-    
-    for (const auto& element : vec) {
-        if (element.documentName == filename && element.word == word)
-            return true;
+    if (options.rankBench > 0) {
+        benchmarkOrderStatistics(cout, options.rankBench);
+        return 0;
     }
-    return false;
-}
+    if (options.swissBench > 0) {
+        benchmarkSwiss(cout, options.swissBench, { 0.25, 0.5, 0.625, 0.75, 0.875 });
+        return 0;
+    }
+    if (!options.layoutBench.empty()) {
+        for (size_t count : options.layoutBench)
+            benchmarkLayouts(cout, count);
+        return 0;
+    }
+
+    // Variables
+    int num_files = 0;
+    vector<string> files_name = options.files; // List of file names
+    Backends indexes; // One search index per dictionary backend
 
+    // The MPH and FC dictionaries are only built by --freeze and only the server queries them
+    bool frozenBackend = options.uses(FrozenDictionary::name()) || options.uses(FrontCodedDictionary::name());
+    if (options.backend != "both" && frozenBackend && !(options.freeze && options.serving())) {
+        cerr << "--backend " << options.backend << " needs --freeze and --serve" << endl;
+        return 1;
+    }
 
-int main() {
-    // Constants
-    const string ITEM_NOT_FOUND = "not found";
+    int selected = options.freeze && (options.uses(FrozenDictionary::name()) || options.uses(FrontCodedDictionary::name()));
+    forEachIndex(indexes, [&](auto & index) { selected += options.uses(index.name()); });
+    if (selected == 0) {
+        cerr << "Unknown backend " << options.backend << endl;
+        return 1;
+    }
 
-    // Variables
-    int num_files;
-    vector<string> files_name; // List of file names
-    AvlTree<string, WordItem *> myTree (ITEM_NOT_FOUND); // AVL tree to store words and their details
-    HashTable<string, WordItem> myHashTable (ITEM_NOT_FOUND);
-    // Input number of files
-    cout << "Enter number of input files: ";
-    cin >> num_files;
+    // Input number of files unless they were given on the command line
+    if (files_name.empty()) {
+        cout << "Enter number of input files: ";
+        cin >> num_files;
+    }
     // Input file names and process each file
     for(int i = 0; i < num_files; i++){
         
@@ -109,301 +99,296 @@ int main() {
         
         files_name.push_back(file_name); // Store file name
     }
-    
-    for (int g = 0; g < files_name.size(); g++){
-        
-        ifstream file;
-        // Open file
-        file.open(files_name[g]);
-        string word;
-        // Read each word from file
-        while (file >> word) {
-            
-            WordItem * n_word = new WordItem;
-            WordItem n_wordhash;
-            word = toLowercase(word); // Convert word to lowercase
-            vector <string> separated_word;
-            removePunctuationAndDigits(word, separated_word); // Remove punctuation and digits from word
-        
-            for (int y = 0; y < separated_word.size(); y++){
-                
-                if (separated_word[y] != ""){ // If word is not empty
-                    
-                    n_word->word_name = separated_word[y]; // Set word name in WordItem
-                    
-                    if(myTree.isEmpty()){ // If tree is empty
-                        
-                        DocumentItem document;
-                        document.documentName = files_name[g];
-                        document.count += 1;
-                        n_word->documents.push_back(document); // Add document to word's document list
-                        myTree.insert(separated_word[y], n_word); // Insert word into AVL tree
-                    }
-                    
-                    else {
-                        // if word is not in tree, insert to tree
-                        if (myTree.find(separated_word[y]) == ITEM_NOT_FOUND){
-                            
-                            DocumentItem document;
-                            document.documentName = files_name[g];
-                            document.count += 1;
-                            n_word->documents.push_back(document); // Add document to word's document list
-                            myTree.insert(separated_word[y], n_word); // Insert word into AVL tree
-                        }
-                        
-                        else {
-                            // if word is in tree, increase count
-                            int index = -1;
-                            WordItem * temp = myTree.update(separated_word[y])->details;
-                            // if document is same, do nothing
-                            if (check_document(temp->documents, files_name[g], index))
-                                temp->documents[index].count += 1; // Increment count
-                            // if document name is different, update the document item
-                            else {
-                                
-                                DocumentItem new_document;
-                                new_document.documentName = files_name[g];
-                                new_document.count += 1;
-                                temp->documents.push_back(new_document); // Add document to word's document list
-                            }
-                        }
-                    }
-                    
-                    // This part is for hash map
-                    n_wordhash.word_name = separated_word[y];
-                    
-                    // if word is not in hashtable, insert to hashtable
-                    if (myHashTable.find(separated_word[y]) == ITEM_NOT_FOUND){
-                        
-                        DocumentItem document;
-                        document.documentName = files_name[g];
-                        document.count += 1;
-                        n_wordhash.documents.push_back(document); // Add document to word's document list
-                        myHashTable.insert(separated_word[y], n_wordhash); // Insert word into AVL tree
-                    }
-                    
-                    else {
-                        // if word is in hashtable, increase count
-                        int index = -1;
-                        WordItem temp = myHashTable.getvalue(separated_word[y]);
-                        
-                        // if document is same, do nothing
-                        if (check_document(temp.documents, files_name[g], index))
-                            temp.documents[index].count += 1; // Increment count
-                        
-                        // if document name is different, update the document item
-                        else {
-                            
-                            DocumentItem new_document;
-                            new_document.documentName = files_name[g];
-                            new_document.count += 1;
-                            temp.documents.push_back(new_document); // Add document to word's document list
-                        }
-                        myHashTable.update(separated_word[y], temp);
-                    }
-                }
+
+    if (options.allocationBudget > 0 && allocationCount() < 0) {
+        cerr << "--alloc-budget needs a build with -DCOUNT_ALLOCATIONS" << endl;
+        return 1;
+    }
+
+    if (options.bloomRate > 0)
+        forEachIndex(indexes, [&](auto & index) { index.enableGuard(options.bloomRate); });
+    forEachIndex(indexes, [&](auto & index) { index.setAggregation(options.aggregate); });
+
+    if (!options.spillBench.empty()) {
+        forEachIndex(indexes, [&](auto & index) {
+            if (options.uses(index.name()))
+                benchmarkSpill(cout, index, files_name, options.spillBench, options.spillPrefix);
+        });
+        return 0;
+    }
+
+    // Preprocess the documents into every structure
+    vector<double> allocationsPerToken;
+    vector<vector<StageTimes>> stageTimes; // Per structure, with --pipeline
+    vector<SpillStats> spillStats; // Per structure, with --spill-budget
+    bool spillFailed = false;
+    forEachIndex(indexes, [&](auto & index) {
+        long long before = allocationCount();
+        if (options.spillBudget > 0) {
+            spillStats.emplace_back();
+            if (!ingestSpilled(index, files_name, options.spillBudget, options.spillPrefix, spillStats.back()))
+                spillFailed = true;
+        }
+        else {
+            if (options.pipelineReaders > 0)
+                stageTimes.push_back(ingestPipelined(index, files_name, options.pipelineReaders));
+            else {
+                for (const string & file_name : files_name)
+                    index.addDocument(file_name);
             }
+            index.finalize(); // ingestSpilled() loads a finalized index
         }
+        if (before >= 0 && index.tokenCount() > 0)
+            allocationsPerToken.push_back((double) (allocationCount() - before) / index.tokenCount());
+    });
+
+    if (spillFailed) {
+        cerr << "Could not write or merge the runs under " << options.spillPrefix << endl;
+        return 1;
     }
-    
-    float ratio = 0;
-    int num = myHashTable.output(ratio);
-    cout << endl << "After preprocessing, the unique word count is " << num << ". Current load ratio is" << endl;
-    cout << ratio << endl;
+
+    cout << endl << "After preprocessing, the unique word count is " << get<0>(indexes).backend().size() << "." << endl;
+    const TermPool & terms = get<0>(indexes).terms();
+    cout << "Term pool: " << terms.size() << " terms in " << terms.termBytes() << " bytes, shared by every structure" << endl;
+    printMemoryReport(cout, "TERMS", terms.memoryUsage());
+    forEachIndex(indexes, [&](auto & index) {
+        cout << index.name() << " preprocessing time: " << index.ingestionTime() / 1e6 << " ms";
+        string summary = index.backend().summary();
+        if (summary != "")
+            cout << ", " << summary;
+        MemoryReport memory = index.backend().memoryUsage();
+        if (index.backend().size() > 0)
+            cout << ", " << memory.total() / index.backend().size() << " bytes/word";
+        cout << endl;
+        printMemoryReport(cout, index.name(), memory);
+        MemoryReport postings = index.postings().memoryUsage();
+        cout << index.name() << " posting store: " << index.postings().postings() << " postings in "
+             << postings.total() / 1024.0 << " KB, " << vectorPostingBytes(index.postings()) / 1024.0
+             << " KB as vector<DocumentItem> per word" << endl;
+        if (index.tokenCount() > 0)
+            cout << index.name() << " dictionary operations: " << index.dictionaryOperations() << " for "
+                 << index.tokenCount() << " tokens, " << (double) index.dictionaryOperations() / index.tokenCount() << " per token" << endl;
+        if (index.hasGuard())
+            cout << index.name() << " Bloom guard: " << index.guard().size() << " words, " << index.guard().bitsPerKey()
+                 << " bits/word, " << index.guard().memoryUsage().total() / 1024.0 << " KB" << endl;
+    });
+
+    // Allocations made while preprocessing, when the build counts them
+    int position = 0;
+    bool overBudget = false;
+    forEachIndex(indexes, [&](auto & index) {
+        if (position >= allocationsPerToken.size())
+            return;
+        double perToken = allocationsPerToken[position++];
+        cout << index.name() << " allocations per token: " << perToken << endl;
+        if (options.allocationBudget > 0 && perToken > options.allocationBudget) {
+            cerr << index.name() << " exceeds the allocation budget of " << options.allocationBudget << " per token" << endl;
+            overBudget = true;
+        }
+    });
+    if (overBudget)
+        return 1;
+
+    // Runs and merge of a memory-bounded ingestion
+    position = 0;
+    forEachIndex(indexes, [&](auto & index) {
+        if (position < spillStats.size())
+            printSpillStats(cout, index.name(), spillStats[position++]);
+    });
+
+    // Where every stage of the ingestion pipeline spent its time
+    position = 0;
+    forEachIndex(indexes, [&](auto & index) {
+        if (position < stageTimes.size())
+            printStageTimes(cout, index.name(), stageTimes[position++]);
+    });
+
+    // Freeze the final vocabulary into a minimal perfect hash for read-only serving
+    FrozenDictionary frozen;
+    FrontCodedDictionary frontCoded;
+    EytzingerIndex<string_view, WordItem> ordered; // Sorted vocabulary in breadth-first order, keys viewing the term pool
+    BloomFilter frozenGuard; // Guards both frozen dictionaries when --bloom is given
+    if (options.freeze) {
+        frozen.build(get<0>(indexes).backend());
+        cout << "MPH freeze: " << frozen.size() << " words in " << frozen.buildTime() / 1e6 << " ms, "
+             << frozen.bitsPerKey() << " bits/key" << endl;
+        printMemoryReport(cout, FrozenDictionary::name(), frozen.memoryUsage());
+
+        // Front code the sorted vocabulary from the in-order walk of the AVL tree
+        frontCoded.build(get<0>(indexes).backend());
+        MemoryReport coded = frontCoded.memoryUsage(), tree = get<0>(indexes).backend().memoryUsage();
+        cout << "FC freeze: " << frontCoded.size() << " words in " << frontCoded.buildTime() / 1e6 << " ms" << endl;
+        printMemoryReport(cout, FrontCodedDictionary::name(), coded);
+        if (frontCoded.size() > 0)
+            cout << "Dictionary without postings: FC " << (coded.total() - coded.postingBytes) / frontCoded.size()
+                 << " bytes/word, " << get<0>(indexes).name() << " " << (tree.total() - tree.postingBytes) / frontCoded.size()
+                 << " bytes/word" << endl;
+
+        // Lay the sorted vocabulary of the AVL tree out in Eytzinger order
+        ordered.build(get<0>(indexes).backend());
+        cout << "EYT freeze: " << ordered.size() << " words in " << ordered.buildTime() / 1e6 << " ms" << endl;
+        printMemoryReport(cout, EytzingerIndex<string_view, WordItem>::name(), ordered.memoryUsage());
+
+        if (options.bloomRate > 0) {
+            frozenGuard.reset(frozen.size(), options.bloomRate);
+            get<0>(indexes).backend().forEach([&](string_view word, const WordItem &) { frozenGuard.add(word); });
+        }
+    }
+    // Lookups into the frozen dictionaries, behind the guard when there is one
+    auto frozenFind = [&](const string & word) -> const WordItem * {
+        return options.bloomRate > 0 && !frozenGuard.mayContain(word) ? nullptr : frozen.find(word);
+    };
+    auto codedFind = [&](const string & word) -> const WordItem * {
+        return options.bloomRate > 0 && !frozenGuard.mayContain(word) ? nullptr : frontCoded.find(word);
+    };
+
+    // Lookup latency of every structure over the same vocabulary
+    if (options.lookupBench || options.freeze) {
+        vector<string> vocabulary;
+        get<0>(indexes).backend().forEach([&](string_view word, const WordItem &) { vocabulary.push_back(string(word)); });
+        forEachIndex(indexes, [&](auto & index) {
+            benchmarkLookups(cout, index.name(), vocabulary, [&](const string & word) { return index.lookup(word); });
+        });
+        if (options.freeze) {
+            benchmarkLookups(cout, FrozenDictionary::name(), vocabulary, frozenFind);
+            benchmarkLookups(cout, FrontCodedDictionary::name(), vocabulary, codedFind);
+            benchmarkLookups(cout, EytzingerIndex<string_view, WordItem>::name(), vocabulary,
+                             [&](const string & word) { return ordered.find(word); });
+        }
+        // Absent words with and without the Bloom guard
+        if (options.bloomRate > 0) {
+            forEachIndex(indexes, [&](auto & index) {
+                benchmarkGuard(cout, index.name(), vocabulary, [&](const string & word) { return index.backend().find(word); },
+                               [&](const string & word) { return index.guard().mayContain(word); });
+            });
+            if (options.freeze) {
+                auto mayContain = [&](const string & word) { return frozenGuard.mayContain(word); };
+                benchmarkGuard(cout, FrozenDictionary::name(), vocabulary, [&](const string & word) { return frozen.find(word); }, mayContain);
+                benchmarkGuard(cout, FrontCodedDictionary::name(), vocabulary, [&](const string & word) { return frontCoded.find(word); }, mayContain);
+            }
+        }
+    }
+
+    if (options.batchLog != "") {
+        vector<string> queries = readQueryLog(options.batchLog);
+        forEachIndex(indexes, [&](auto & index) {
+            benchmarkBatches(cout, index.name(), queries, [&](const string & word) { return index.lookup(word); });
+        });
+    }
+    if (options.parallelLog != "") {
+        vector<string> queries = readQueryLog(options.parallelLog);
+        forEachIndex(indexes, [&](auto & index) {
+            if (options.uses(index.name()))
+                benchmarkParallel(cout, index.name(), queries, options.queryThreads,
+                                  [&](const string & word) { return index.lookup(word); });
+        });
+    }
+    if (options.shardLog != "") {
+        vector<string> queries = readQueryLog(options.shardLog);
+        forEachIndex(indexes, [&](auto & index) {
+            if (options.uses(index.name()))
+                benchmarkShards(cout, index, files_name, options.shardCounts, options.shardProcesses, options.shardPrefix, queries);
+        });
+    }
+    if (options.viewLog != "") {
+        vector<string> queries = readQueryLog(options.viewLog);
+        forEachIndex(indexes, [&](auto & index) {
+            if (options.uses(index.name()))
+                benchmarkViews(cout, index.name(), queries, files_name, [&](const string & word) { return index.lookup(word); },
+                               allocationCount);
+        });
+    }
+    if (options.cacheLog != "") {
+        vector<string> queries = readQueryLog(options.cacheLog);
+        forEachIndex(indexes, [&](auto & index) {
+            benchmarkCache(cout, index.name(), queries, 100000, options.cacheBudget,
+                           [&](const string & word) { return index.lookup(word); });
+        });
+    }
+    if (options.queryLog != "") {
+        vector<string> log = readReplayLog(options.queryLog);
+        forEachIndex(indexes, [&](auto & index) {
+            if (!options.uses(index.name()))
+                return;
+            QueryCache cache(options.cacheBudget);
+            index.attachCache(options.useCache ? &cache : nullptr);
+            replayQueries(cout, index.name(), log, options.concurrency, options.useCache ? &cache : nullptr,
+                          [&](const string & word) { return index.lookup(word); },
+                          [&](const string & word) { index.remove(word); });
+            index.attachCache(nullptr);
+        });
+    }
+    if (options.serving()) {
+        // One structure serves; "both" means the hash table
+        SearchOptions served = options;
+        if (served.backend == "both")
+            served.backend = "hash";
+        int status = -1;
+        if (options.freeze && served.uses(FrozenDictionary::name()))
+            status = serveQueries(cout, options.serveUnix, options.servePort, options.workers,
+                                  frozenFind);
+        if (status == -1 && options.freeze && served.uses(FrontCodedDictionary::name()))
+            status = serveQueries(cout, options.serveUnix, options.servePort, options.workers,
+                                  codedFind);
+        forEachIndex(indexes, [&](auto & index) {
+            if (status == -1 && served.uses(index.name()))
+                status = serveQueries(cout, options.serveUnix, options.servePort, options.workers,
+                                      [&](const string & word) { return index.lookup(word); });
+        });
+        return status == -1 ? 1 : status;
+    }
+    if (options.batchLog != "" || options.parallelLog != "" || options.shardLog != "" || options.viewLog != "" || options.cacheLog != ""
+        || options.queryLog != "")
+        return 0;
     
     bool flag = true;
     string query;
+    PhaseTracer tracer; // Phase timings of the queries, with --trace
+    tracer.keepEvents(options.traceJson != "");
+    int parsing = tracer.track("QUERY");
+    vector<int> tracks;
+    forEachIndex(indexes, [&](auto & index) { tracks.push_back(tracer.track(index.name())); });
 
     // Input query words until "ENDOFINPUT" is entered
     while (flag) {
         
         cout << "Enter queried words in one line: ";
-        vector<string> BST_words;
-        vector<string> HASH_words;
-        getline(cin, query); // Read the entire line of input
-
-        if (query == "ENDOFINPUT")
-            flag = false; // Stop loop if "ENDOFINPUT" is entered
+        // Read the entire line of input
+        if (!getline(cin, query) || query == "ENDOFINPUT")
+            flag = false; // Stop loop if "ENDOFINPUT" is entered or the input ends
         
+        else if (options.trace && query == "TRACE")
+            tracer.print(cout); // Phase histograms so far
+
         else {
             
-            istringstream iss(query); // Create a stringstream to tokenize the input
-            string word;
-            // Tokenize the input line
-            while (iss >> word) {
-                toLowercase(word);
-                vector <string> separated_words;
-                removePunctuationAndDigits(word, separated_words);
-                
-                for (int z = 0; z < separated_words.size(); z++){
-                    
-                    if (separated_words[z] != ""){
-                        BST_words.push_back(separated_words[z]); // Store each word in the vector
-                        HASH_words.push_back(separated_words[z]);
-                    }
-                }
-            }
-
-            bool controlBST = true, controlHASH = true;
-            vector<WordOutput> BST_word_details, BST_found_word;
-            vector<WordOutput> HASH_word_details, HASH_found_word;
-
+            tracer.beginQuery();
+            auto parseStart = chrono::high_resolution_clock::now();
+            vector<string> words = parseQuery(query); // Tokenize the input line
+            if (options.trace)
+                tracer.record(parsing, PhaseParse, parseStart, chrono::high_resolution_clock::now());
             int k = 20;
-            auto start = std::chrono::high_resolution_clock::now();
-            for (int i = 0; i < k; i++){
-                // Process each word in the query
-                for (int a = 0; a< BST_words.size(); a++){
-                    
-                    if (BST_words[0] == "remove"){ // Check if the command is to remove a word
-                        
-                        myTree.remove(BST_words[1]);
-                        cout << BST_words[1] << " has been REMOVED" << endl;
-                        BST_words.clear();
-                        controlBST = false;
-                        break;
-                    }
-                    // Check if word exists in the AVL tree
-                    if (myTree.find(BST_words[a]) != ITEM_NOT_FOUND){
-                        // Get word information
-                        WordItem * word_information = myTree.update(BST_words[a])->details;
-                        
-                        for (int c = 0; c < word_information->documents.size(); c++){
-                            
-                            WordOutput temp;
-                            temp.documentName = word_information->documents[c].documentName;
-                            temp.count = word_information->documents[c].count;
-                            temp.word = BST_words[a];
-                            BST_word_details.push_back(temp);
-                        }
-                    }
-                }
-            }
-            auto BSTTime = std::chrono::duration_cast<std::chrono::nanoseconds> (std::chrono::high_resolution_clock::now() - start);
-              
-                      
-          bool checkBST = false;
-          if (controlBST){
-              // Check if all words in query exist in any document
-              for (int a = 0; a < files_name.size(); a++){
-                  
-                  int num = 0;
-                  for (int b = 0; b < BST_words.size(); b++){
-                      if(isFoundWordInVector(BST_word_details, files_name[a], BST_words[b]))
-                          num++;
-                  }
-                  if (num == BST_words.size()){
-                      checkBST = true;
-                  }
-              }
+            vector<long long> times;
+            vector<string> names;
+            forEachIndex(indexes, [&](auto & index) {
+                times.push_back(interactiveQuery(index, words, k, options.trace ? &tracer : nullptr, tracks[names.size()]));
+                names.push_back(index.name());
+            });
 
-              if (!checkBST)
-                  cout << "No document contains the given query" << endl; // No document contains all the queried words
-              else {
-                  // Print occurrences of queried words in each document
-                  BST_found_word.clear();
-                  for (int i = 0; i < files_name.size(); i++){
-                      
-                      isWordInVector(BST_word_details, BST_found_word, files_name[i]);
-                      
-                      if (BST_found_word.size()/20 == BST_words.size()){
-                          
-                          cout << "in Document " << files_name[i] << ", ";
-                          for (int j = 0; j < BST_words.size(); j++){
-                              
-                              for (int k = 0; k < BST_found_word.size()/20; k++){
-                                  
-                                  if (j != BST_found_word.size()/20-1 && BST_words[j] == BST_found_word[k].word)
-                                      cout << BST_words[j] << " found " << BST_found_word[k].count << " times, ";
-                                  else if (j == BST_found_word.size()/20-1 && BST_words[j] == BST_found_word[k].word)
-                                      cout << BST_words[j] << " found " << BST_found_word[k].count << " times." << endl;;
-                              }
-                          }
-                      }
-                      BST_found_word.clear();
-                  }
-              }
-          }
-            
-      start = std::chrono::high_resolution_clock::now();
-      for (int i = 0; i < k; i++)
-      {
-          // For hash table
-          
-          // Process each word in the query
-          for (int a = 0; a< HASH_words.size(); a++){
-              
-              if (HASH_words[0] == "remove"){ // Check if the command is to remove a word
-                  myHashTable.remove(HASH_words[1]);
-                  cout << HASH_words[1] << " has been REMOVED" << endl;
-                  HASH_words.clear();
-                  controlHASH = false;
-                  break;
-              }
-              // Check if word exists in the hashtable
-              if (myHashTable.find(HASH_words[a]) != ITEM_NOT_FOUND){
-                  // Get word information
-                  WordItem word_information = myHashTable.getvalue(HASH_words[a]);
-                  
-                  for (int c = 0; c < word_information.documents.size(); c++){
-                      
-                      WordOutput temp;
-                      temp.documentName = word_information.documents[c].documentName;
-                      temp.count = word_information.documents[c].count;
-                      temp.word = HASH_words[a];
-                      HASH_word_details.push_back(temp);
-                  }
-              }
-          }
+            cout << endl;
+            for (int i = 0; i < times.size(); i++)
+                cout << names[i] << " Time: " << times[i] / k << "\n";
+            for (int i = 1; i < times.size(); i++)
+                cout << "Speed Up " << names[0] << "/" << names[i] << ": " << (float) times[0] / times[i] << endl;
+        }
+        cout << endl;
     }
-    auto HTTime = std::chrono::duration_cast<std::chrono::nanoseconds> (std::chrono::high_resolution_clock::now() - start);
-          
-  bool checkHASH = false;
-  if (controlHASH){
-      // Check if all words in query exist in any document
-      for (int a = 0; a < files_name.size(); a++){
-          
-          int num = 0;
-          for (int b = 0; b < HASH_words.size(); b++){
-              if(isFoundWordInVector(HASH_word_details, files_name[a], HASH_words[b]))
-                  num++;
-          }
-          if (num == HASH_words.size()){
-              checkHASH = true;
-          }
-      }
-
-      if (!checkHASH)
-          cout << "No document contains the given query" << endl; // No document contains all the queried words
-      else {
-          // Print occurrences of queried words in each document
-          HASH_found_word.clear();
-          for (int i = 0; i < files_name.size(); i++){
-              
-              isWordInVector(HASH_word_details, HASH_found_word, files_name[i]);
-              if (HASH_found_word.size()/20 == HASH_words.size()){
-                  
-                  cout << "in Document " << files_name[i] << ", ";
-                  for (int j = 0; j < HASH_words.size(); j++){
-                      
-                      for (int k = 0; k < HASH_found_word.size()/20; k++){
-                          
-                          if (j != HASH_found_word.size()/20-1 && HASH_words[j] == HASH_found_word[k].word)
-                              cout << HASH_words[j] << " found " << HASH_found_word[k].count << " times, ";
-                          else if (j == HASH_found_word.size()/20-1 && HASH_words[j] == HASH_found_word[k].word)
-                              cout << HASH_words[j] << " found " << HASH_found_word[k].count << " times." << endl;;
-                      }
-                  }
-              }
-              HASH_found_word.clear();
-          }
-     }
- }
-        cout << "\nTime: " << BSTTime.count() / k << "\n";
-        cout << "Time: " << HTTime.count() / k << "\n";
-        cout << "Speed Up: " <<  (float) BSTTime.count() / HTTime.count( )<< endl;
+    if (options.trace)
+        tracer.print(cout);
+    if (options.traceJson != "" && !tracer.writeChromeTrace(options.traceJson)) {
+        cerr << "Could not write " << options.traceJson << endl;
+        return 1;
     }
-        cout << endl;
-  }
     return 0;
 }
 // SÜLEYMAN BERBER
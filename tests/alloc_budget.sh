@@ -0,0 +1,43 @@
+#!/bin/sh
+# Ingestion must stay within ALLOC_BUDGET allocations per token (default
+# 0.1) in every structure. Builds with -DCOUNT_ALLOCATIONS, indexes a fixed
+# generated corpus with --alloc-budget and fails if the run does. A budget
+# no structure can meet is also tried, to check that it is enforced.
+# Run from anywhere: tests/alloc_budget.sh
+set -e
+root=$(cd "$(dirname "$0")/.." && pwd)
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+budget=${ALLOC_BUDGET:-0.1}
+
+${CXX:-g++} -std=c++17 -O2 -pthread -DCOUNT_ALLOCATIONS -o "$work/se" "$root/main.cpp"
+
+# 8 documents of 20000 words drawn from 5000, the same on every run
+awk -v dir="$work" 'BEGIN {
+    seed = 12345
+    for (d = 0; d < 8; d++) {
+        file = dir "/doc" d ".txt"
+        for (w = 0; w < 20000; w++) {
+            seed = (seed * 1103515245 + 12345) % 2147483648
+            id = int(seed / 65536) % 5000
+            word = ""
+            do { word = word sprintf("%c", 97 + id % 26); id = int(id / 26) } while (id > 0)
+            printf "%s%s", word, (w % 12 == 11 ? ".\n" : " ") > file
+        }
+        close(file)
+    }
+}'
+
+cd "$work"
+if ! printf 'ENDOFINPUT\n' | ./se --files doc*.txt --alloc-budget "$budget" > out 2> err; then
+    cat err
+    grep 'allocations per token' out
+    echo "alloc_budget: FAILED"
+    exit 1
+fi
+if printf 'ENDOFINPUT\n' | ./se --files doc*.txt --alloc-budget 0.0000001 > /dev/null 2>&1; then
+    echo "alloc_budget: a budget of 1e-7 allocations per token was not enforced"
+    exit 1
+fi
+grep 'allocations per token' out
+echo "alloc_budget: passed (budget $budget)"
@@ -0,0 +1,29 @@
+#!/bin/sh
+# A file listed twice is indexed as one document whose counts are summed,
+# and every structure prints it once. Run from anywhere: tests/repeated_files.sh
+set -e
+root=$(cd "$(dirname "$0")/.." && pwd)
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+${CXX:-g++} -std=c++17 -O2 -pthread -o "$work/se" "$root/main.cpp"
+
+cd "$root/tests/corpus"
+printf 'fox\nthe dog\nENDOFINPUT\n' | "$work/se" --files a.txt b.txt c.txt a.txt > "$work/out"
+
+structures=$(grep -c ' Time: ' "$work/out")
+structures=$((structures / 2))
+grep 'in Document ' "$work/out" | sed 's/^.*in Document /in Document /' | sort | uniq -c | sed 's/^ *//' > "$work/got"
+cat > "$work/lines" <<END
+in Document a.txt, fox found 4 times.
+in Document a.txt, the found 10 times, dog found 4 times.
+in Document b.txt, fox found 1 times.
+in Document c.txt, the found 3 times, dog found 1 times.
+END
+sed "s/^/$structures /" "$work/lines" > "$work/expected"
+
+if ! diff "$work/expected" "$work/got"; then
+    echo "repeated_files: FAILED"
+    exit 1
+fi
+echo "repeated_files: passed ($structures structures)"
@@ -0,0 +1,22 @@
+#!/bin/sh
+# Sharded indexes, in threads and in processes, answer every query of the
+# fixed corpus like the unsharded index, with a file listed twice.
+# Run from anywhere: tests/shards.sh
+set -e
+root=$(cd "$(dirname "$0")/.." && pwd)
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+${CXX:-g++} -std=c++17 -O2 -pthread -o "$work/se" "$root/main.cpp"
+
+cd "$root/tests/corpus"
+for mode in threads processes; do
+    printf 'ENDOFINPUT\n' | "$work/se" --files a.txt b.txt c.txt a.txt --shard-bench queries.txt --shards 1,2,3 \
+        --shard-mode "$mode" > "$work/out" 2>&1
+    runs=$(grep -c ' shards in ' "$work/out" || true)
+    if [ "$runs" -eq 0 ] || grep 'RESULTS DIFFER' "$work/out"; then
+        echo "shards: FAILED in $mode"
+        exit 1
+    fi
+done
+echo "shards: passed"